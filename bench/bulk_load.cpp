@@ -0,0 +1,56 @@
+#include "OLC_BTree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Compares building a tree from sorted input with bulkLoad and bulkLoadParallel against
+// per-key upserts and against plainly copying the input.
+// -------------------------------------------------------------------------------------
+
+template <class Fn>
+static double seconds(Fn&& fn) {
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 50'000'000;
+   std::vector<Key> keys(n);
+   std::vector<Payload> payloads(n);
+   for (uint64_t i = 0; i < n; ++i) {
+      keys[i] = 2 * i;
+      payloads[i] = i;
+   }
+
+   std::vector<Key> keyCopy(n);
+   std::vector<Payload> payloadCopy(n);
+   double copy = seconds([&]() {
+      std::memcpy(keyCopy.data(), keys.data(), sizeof(Key) * n);
+      std::memcpy(payloadCopy.data(), payloads.data(), sizeof(Payload) * n);
+   });
+   std::cout << "memcpy      " << n / copy / 1e6 << " M entries/s" << std::endl;
+
+   {
+      OLC_BTree tree;
+      double t = seconds([&]() { tree.bulkLoad(keys.data(), payloads.data(), n, 1.0); });
+      std::cout << "bulkLoad    " << n / t / 1e6 << " M entries/s, height " << tree.getHeight() << std::endl;
+   }
+   for (unsigned threads = 2; threads <= std::thread::hardware_concurrency(); threads *= 2) {
+      OLC_BTree tree;
+      double t = seconds([&]() { tree.bulkLoadParallel(keys.data(), payloads.data(), n, 1.0, threads); });
+      std::cout << "parallel " << threads << (threads < 10 ? "  " : " ") << n / t / 1e6 << " M entries/s" << std::endl;
+   }
+   {
+      OLC_BTree tree;
+      double t = seconds([&]() {
+         for (uint64_t i = 0; i < n; ++i) tree.upsert(keys[i], payloads[i]);
+      });
+      std::cout << "upsert      " << n / t / 1e6 << " M entries/s, height " << tree.getHeight() << std::endl;
+   }
+   return EXIT_SUCCESS;
+}
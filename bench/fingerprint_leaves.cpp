@@ -0,0 +1,57 @@
+#include "OLC_BTree.hpp"
+#include "FingerprintNodes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Compares packed and fingerprinted leaves on an ingest of random keys, followed by point
+// lookups and short scans, which have to sort the copies of unsorted leaves.
+// -------------------------------------------------------------------------------------
+
+template <class Fn>
+static double seconds(Fn&& fn) {
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Nodes>
+static void run(const char* name, const std::vector<Key>& keys, uint64_t scans) {
+   OLC_BTree<Key, Payload, OptLatch, Nodes> tree;
+   double upsert = seconds([&]() {
+      for (Key k : keys) tree.upsert(k, k);
+   });
+   uint64_t missing = 0;
+   double lookup = seconds([&]() {
+      Payload result = 0;
+      for (Key k : keys) {
+         if (!tree.lookup(k, result)) ++missing;
+      }
+   });
+   std::vector<Key> keysOut(100);
+   std::vector<Payload> payloadsOut(100);
+   double scan = seconds([&]() {
+      for (uint64_t i = 0; i < scans; ++i) tree.scan(keys[i], 100, keysOut.data(), payloadsOut.data());
+   });
+   if (missing > 0) std::cerr << name << " lost " << missing << " keys" << std::endl;
+   std::cout << "  " << name << " upsert " << keys.size() / upsert / 1e6 << " M ops/s, lookup "
+             << keys.size() / lookup / 1e6 << " M ops/s, scan of 100 " << scans / scan / 1e6 << " M ops/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+   uint64_t scans = std::min<uint64_t>(n, 1'000'000);
+
+   std::vector<Key> keys(n);
+   std::mt19937_64 rng(42);
+   for (Key& k : keys) k = rng();
+   std::cout << "random keys, " << n << " keys" << std::endl;
+   run<PackedNodes>("packed", keys, scans);
+   run<FingerprintNodes>("fingerprint", keys, scans);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include "OLC_BTree.hpp"
+#include "GappedNodes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Compares packed and gapped leaves on an ingest of random keys, where every insert into a
+// packed leaf shifts half of its entries, followed by point lookups and removes. The leaf
+// runs take the tree out of the picture: half full leaves, like after a split, are filled up
+// with random keys.
+// -------------------------------------------------------------------------------------
+
+template <class Fn>
+static double seconds(Fn&& fn) {
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Nodes>
+static void run(const char* name, const std::vector<Key>& keys) {
+   OLC_BTree<Key, Payload, OptLatch, Nodes> tree;
+   double upsert = seconds([&]() {
+      for (Key k : keys) tree.upsert(k, k);
+   });
+   uint64_t missing = 0;
+   double lookup = seconds([&]() {
+      Payload result = 0;
+      for (Key k : keys) {
+         if (!tree.lookup(k, result)) ++missing;
+      }
+   });
+   double remove = seconds([&]() {
+      for (uint64_t i = 0; i < keys.size(); i += 2) {
+         if (!tree.remove(keys[i])) ++missing;
+      }
+   });
+   if (missing > 0) std::cerr << name << " lost " << missing << " keys" << std::endl;
+   std::cout << "  " << name << " upsert " << keys.size() / upsert / 1e6 << " M ops/s, lookup "
+             << keys.size() / lookup / 1e6 << " M ops/s, remove " << keys.size() / 2 / remove / 1e6 << " M ops/s"
+             << std::endl;
+}
+
+template <class Leaf>
+static void runLeaves(const char* name, uint64_t numLeaves) {
+   std::mt19937_64 rng(42);
+   const uint64_t loaded = Leaf::maxEntries / 2;
+   const uint64_t perLeaf = Leaf::maxEntries - loaded;
+   std::vector<std::unique_ptr<Leaf>> leaves(numLeaves);
+   std::vector<Key> inserted(numLeaves * perLeaf);
+   std::vector<Key> keys(loaded);
+   std::vector<Payload> payloads(loaded);
+   for (uint64_t l = 0; l < numLeaves; ++l) {
+      for (Key& k : keys) k = rng();
+      std::sort(keys.begin(), keys.end());
+      leaves[l] = std::make_unique<Leaf>();
+      leaves[l]->load(keys.data(), payloads.data(), loaded, nullptr, nullptr);
+      for (uint64_t i = 0; i < perLeaf; ++i) inserted[l * perLeaf + i] = rng();
+   }
+   double insert = seconds([&]() {
+      for (uint64_t l = 0; l < numLeaves; ++l) {
+         for (uint64_t i = 0; i < perLeaf; ++i) leaves[l]->insert(inserted[l * perLeaf + i], i);
+      }
+   });
+   std::cout << "  " << name << " leaf insert " << inserted.size() / insert / 1e6 << " M ops/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+
+   std::vector<Key> keys(n);
+   std::mt19937_64 rng(42);
+   for (Key& k : keys) k = rng();
+   std::cout << "random keys, " << n << " keys" << std::endl;
+   run<PackedNodes>("packed", keys);
+   run<GappedNodes>("gapped", keys);
+   std::cout << "half full leaves, " << n / BTreeLeaf<>::maxEntries << " leaves" << std::endl;
+   runLeaves<BTreeLeaf<>>("packed", n / BTreeLeaf<>::maxEntries);
+   runLeaves<GappedLeaf<>>("gapped", n / BTreeLeaf<>::maxEntries);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+#include "OLC_BTree.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Upserts and lookups of Zipf distributed keys, so most operations hit a few hot leaves.
+// Compares the backoff policies of the retry loops.
+// -------------------------------------------------------------------------------------
+
+// Zipf generator of Gray et al., "Quickly Generating Billion-Record Synthetic Databases".
+class ZipfGenerator {
+   uint64_t n;
+   double theta, alpha, zetan, eta;
+
+  public:
+   ZipfGenerator(uint64_t n, double theta) : n(n), theta(theta) {
+      double zeta2 = 1.0 + std::pow(0.5, theta);
+      zetan = 0;
+      for (uint64_t i = 1; i <= n; ++i) zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+      alpha = 1.0 / (1.0 - theta);
+      eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+   }
+
+   template <class Rng>
+   uint64_t operator()(Rng& rng) {
+      double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+      double uz = u * zetan;
+      if (uz < 1.0) return 0;
+      if (uz < 1.0 + std::pow(0.5, theta)) return 1;
+      return static_cast<uint64_t>(n * std::pow(eta * u - eta + 1.0, alpha)) % n;
+   }
+};
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+   unsigned numThreads = (argc > 2) ? std::atoi(argv[2]) : std::max(4u, std::thread::hardware_concurrency());
+   double theta = (argc > 3) ? std::atof(argv[3]) : 0.99;
+   uint64_t opsPerThread = 2'000'000;
+
+   std::vector<Key> keys(n);
+   std::vector<Payload> payloads(n);
+   for (uint64_t i = 0; i < n; ++i) {
+      keys[i] = i;
+      payloads[i] = i;
+   }
+
+   // rank 0 is the hottest key, neighbouring ranks share leaves
+   ZipfGenerator zipf(n, theta);
+   std::vector<std::vector<Key>> probes(numThreads);
+   for (unsigned t = 0; t < numThreads; ++t) {
+      std::mt19937_64 rng(t);
+      probes[t].resize(opsPerThread);
+      for (auto& probe : probes[t]) probe = zipf(rng);
+   }
+
+   struct Config {
+      const char* name;
+      BackoffPolicy policy;
+   };
+   Config configs[] = {
+      {"spin       ", {BackoffPolicy::Kind::Spin, 0, 0}},
+      {"pause      ", {BackoffPolicy::Kind::Pause, 0, 0}},
+      {"exponential", {BackoffPolicy::Kind::Exponential, 1024, 0}},
+      {"exp + yield", {BackoffPolicy::Kind::Exponential, 1024, 16}},
+   };
+
+   std::cout << numThreads << " threads, theta " << theta << ", 50% upserts" << std::endl;
+   for (const Config& config : configs) {
+      OLC_BTree tree;
+      tree.bulkLoad(keys.data(), payloads.data(), n, 0.8);
+      tree.setBackoffPolicy(config.policy);
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (unsigned t = 0; t < numThreads; ++t) {
+         threads.emplace_back([&, t]() {
+            Payload result = 0;
+            for (uint64_t i = 0; i < opsPerThread; ++i) {
+               Key k = probes[t][i];
+               if (i & 1) {
+                  tree.upsert(k, i);
+               } else {
+                  tree.lookup(k, result);
+               }
+            }
+         });
+      }
+      for (auto& thread : threads) thread.join();
+      double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      ContentionStats stats = tree.stats();
+      std::cout << config.name << " " << numThreads * opsPerThread / t / 1e6 << " M ops/s, "
+                << stats.total() << " restarts (" << stats.total(RestartCause::Locked) << " locked, "
+                << stats.total(RestartCause::VersionChanged) << " version changed), "
+                << stats.sharedFallbacks[static_cast<unsigned>(TreeOperation::Lookup)] << " shared lookups" << std::endl;
+   }
+   return EXIT_SUCCESS;
+}
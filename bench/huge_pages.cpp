@@ -0,0 +1,71 @@
+#include "OLC_BTree.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <random>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Random lookups on a large tree with regular and with huge page backed nodes. Reports
+// dTLB load misses per lookup if perf counters are accessible.
+// -------------------------------------------------------------------------------------
+
+static int openDtlbMissCounter() {
+   perf_event_attr attr;
+   std::memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HW_CACHE;
+   attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+   attr.disabled = 1;
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void run(const char* name, NodeAllocMode mode, const std::vector<Key>& keys, const std::vector<Key>& probes) {
+   OLC_BTree tree(mode);
+   std::vector<Payload> payloads(keys.begin(), keys.end());
+   tree.bulkLoad(keys.data(), payloads.data(), keys.size(), 0.8);
+
+   int counter = openDtlbMissCounter();
+   if (counter >= 0) {
+      ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+   }
+   auto start = std::chrono::steady_clock::now();
+   uint64_t hits = 0;
+   for (Key probe : probes) {
+      Payload result;
+      hits += tree.lookup(probe, result);
+   }
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   std::cout << name << probes.size() / seconds / 1e6 << " M lookups/s";
+   uint64_t misses = 0;
+   if (counter >= 0 && read(counter, &misses, sizeof(misses)) == sizeof(misses)) {
+      std::cout << ", " << static_cast<double>(misses) / probes.size() << " dTLB misses/lookup";
+   } else {
+      std::cout << ", dTLB misses n/a (perf_event_open not permitted)";
+   }
+   std::cout << (hits == probes.size() ? "" : ", WRONG RESULTS") << std::endl;
+   if (counter >= 0) close(counter);
+}
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 50'000'000;
+   std::vector<Key> keys(n);
+   for (uint64_t i = 0; i < n; ++i) keys[i] = i;
+   std::mt19937_64 rng(42);
+   std::vector<Key> probes(10'000'000);
+   for (auto& probe : probes) probe = rng() % n;
+
+   run("4KB pages   ", NodeAllocMode::Default, keys, probes);
+   run("huge pages  ", NodeAllocMode::HugePages, keys, probes);
+   return EXIT_SUCCESS;
+}
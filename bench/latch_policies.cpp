@@ -0,0 +1,89 @@
+#include "OLC_BTree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Compares the latch policies of the tree. A single-threaded load phase with upserts and
+// lookups of random keys runs with all three, mixed concurrent lookups and upserts only
+// with the latches that support concurrency.
+// -------------------------------------------------------------------------------------
+
+template <class Fn>
+static double seconds(Fn&& fn) {
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Latch>
+static void loadPhase(const char* name, const std::vector<Key>& keys) {
+   OLC_BTree<Key, Payload, Latch> tree;
+   double upsert = seconds([&]() {
+      for (Key k : keys) tree.upsert(k, k);
+   });
+   uint64_t missing = 0;
+   double lookup = seconds([&]() {
+      Payload result = 0;
+      for (Key k : keys) {
+         if (!tree.lookup(k, result)) ++missing;
+      }
+   });
+   if (missing > 0) std::cerr << name << " lost " << missing << " keys" << std::endl;
+   std::cout << name << " upsert " << keys.size() / upsert / 1e6 << " M ops/s, lookup "
+             << keys.size() / lookup / 1e6 << " M ops/s" << std::endl;
+}
+
+template <class Latch>
+static void concurrentPhase(const char* name, const std::vector<Key>& keys, unsigned numThreads,
+                            unsigned upsertPercent) {
+   OLC_BTree<Key, Payload, Latch> tree;
+   for (Key k : keys) tree.upsert(k, k);
+   uint64_t opsPerThread = keys.size();
+   double t = seconds([&]() {
+      std::vector<std::thread> threads;
+      for (unsigned thread = 0; thread < numThreads; ++thread) {
+         threads.emplace_back([&, thread]() {
+            std::mt19937_64 rng(thread);
+            Payload result = 0;
+            for (uint64_t i = 0; i < opsPerThread; ++i) {
+               Key k = keys[rng() % keys.size()];
+               if (rng() % 100 < upsertPercent) {
+                  tree.upsert(k, i);
+               } else {
+                  tree.lookup(k, result);
+               }
+            }
+         });
+      }
+      for (auto& thread : threads) thread.join();
+   });
+   std::cout << name << " " << upsertPercent << "% upserts " << numThreads * opsPerThread / t / 1e6 << " M ops/s, "
+             << tree.stats().total() << " restarts" << std::endl;
+}
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+   unsigned numThreads = (argc > 2) ? std::atoi(argv[2]) : std::max(4u, std::thread::hardware_concurrency());
+
+   std::vector<Key> keys(n);
+   for (uint64_t i = 0; i < n; ++i) keys[i] = i;
+   std::shuffle(keys.begin(), keys.end(), std::mt19937_64(42));
+
+   std::cout << "single-threaded, " << n << " random keys" << std::endl;
+   loadPhase<OptLatch>("optimistic", keys);
+   loadPhase<RWLatch>("rw        ", keys);
+   loadPhase<NoLatch>("none      ", keys);
+
+   std::cout << numThreads << " threads" << std::endl;
+   for (unsigned upsertPercent : {5u, 50u}) {
+      concurrentPhase<OptLatch>("optimistic", keys, numThreads, upsertPercent);
+      concurrentPhase<RWLatch>("rw        ", keys, numThreads, upsertPercent);
+   }
+   return EXIT_SUCCESS;
+}
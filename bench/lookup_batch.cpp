@@ -0,0 +1,62 @@
+#include "OLC_BTree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Random point lookups on a tree much larger than the LLC, one by one, batched and as
+// interleaved coroutines.
+// -------------------------------------------------------------------------------------
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 50'000'000;
+   uint64_t numLookups = 10'000'000;
+
+   std::vector<Key> keys(n);
+   std::vector<Payload> payloads(n);
+   for (uint64_t i = 0; i < n; ++i) {
+      keys[i] = i;
+      payloads[i] = i;
+   }
+   OLC_BTree tree;
+   tree.bulkLoad(keys.data(), payloads.data(), n, 0.8);
+
+   std::mt19937_64 rng(42);
+   std::vector<Key> probes(numLookups);
+   for (auto& probe : probes) probe = rng() % n;
+   std::vector<Payload> out(numLookups);
+   std::unique_ptr<bool[]> found(new bool[numLookups]);
+
+   auto start = std::chrono::steady_clock::now();
+   uint64_t hits = 0;
+   for (uint64_t i = 0; i < numLookups; ++i) hits += tree.lookup(probes[i], out[i]);
+   double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   start = std::chrono::steady_clock::now();
+   tree.lookupBatch(probes.data(), out.data(), found.get(), numLookups);
+   double batched = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   for (uint64_t i = 0; i < numLookups; ++i) hits -= found[i];
+
+   start = std::chrono::steady_clock::now();
+   {
+      // spawn in chunks, so the coroutine frames of all lookups are not allocated at once
+      CoroScheduler scheduler(16);
+      for (uint64_t chunk = 0; chunk < numLookups; chunk += 1024) {
+         for (uint64_t i = chunk; i < std::min(numLookups, chunk + 1024); ++i) {
+            scheduler.spawn(tree.lookupAsync(probes[i], out[i], found[i]));
+         }
+         scheduler.run();
+      }
+   }
+   double coroutines = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   std::cout << "lookup       " << numLookups / single / 1e6 << " M lookups/s" << std::endl;
+   std::cout << "lookupBatch  " << numLookups / batched / 1e6 << " M lookups/s" << std::endl;
+   std::cout << "lookupAsync  " << numLookups / coroutines / 1e6 << " M lookups/s" << std::endl;
+   return hits == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
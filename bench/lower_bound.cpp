@@ -0,0 +1,78 @@
+#include "NodeSearch.hpp"
+#include "OLC_BTree.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Compares the node search kernels on a single node worth of keys for different fill
+// levels. Many nodes are searched round robin, so the keys are not always in L1.
+// -------------------------------------------------------------------------------------
+
+static constexpr unsigned numNodes = 1024;
+static constexpr unsigned lookupsPerRun = 1 << 22;
+
+struct Kernel {
+   const char* name;
+   LowerBoundFn fn;
+   bool supported;
+};
+
+int main() {
+   __builtin_cpu_init();
+   std::vector<Kernel> kernels = {
+      {"binary", lowerBoundScalar, true},
+      {"sse4.2", lowerBoundSSE, __builtin_cpu_supports("sse4.2") != 0},
+      {"avx2", lowerBoundAVX2, __builtin_cpu_supports("avx2") != 0},
+      {"avx512", lowerBoundAVX512, __builtin_cpu_supports("avx512f") != 0},
+   };
+   std::cout << "dispatched kernel: " << lowerBoundKernelName() << std::endl;
+
+   std::mt19937_64 rng(42);
+   std::vector<unsigned> fills = {8, 16, 32, 64, 128, static_cast<unsigned>(BTreeLeaf<>::maxEntries)};
+
+   std::cout << std::setw(8) << "fill";
+   for (auto& kernel : kernels) std::cout << std::setw(12) << kernel.name;
+   std::cout << "   (ns per search)" << std::endl;
+
+   for (unsigned fill : fills) {
+      std::vector<uint64_t> keys(numNodes * BTreeLeaf<>::maxEntries);
+      for (unsigned n = 0; n < numNodes; ++n) {
+         uint64_t* node = keys.data() + n * BTreeLeaf<>::maxEntries;
+         for (unsigned i = 0; i < fill; ++i) node[i] = rng();
+         std::sort(node, node + fill);
+      }
+      std::vector<uint64_t> probes(lookupsPerRun);
+      for (auto& probe : probes) probe = rng();
+
+      std::cout << std::setw(8) << fill;
+      uint64_t expected = 0;
+      for (auto& kernel : kernels) {
+         if (!kernel.supported) {
+            std::cout << std::setw(12) << "-";
+            continue;
+         }
+         uint64_t checksum = 0;
+         auto start = std::chrono::steady_clock::now();
+         for (unsigned i = 0; i < lookupsPerRun; ++i) {
+            const uint64_t* node = keys.data() + (i % numNodes) * BTreeLeaf<>::maxEntries;
+            checksum += kernel.fn(node, fill, probes[i]);
+         }
+         auto end = std::chrono::steady_clock::now();
+         if (kernel.fn == lowerBoundScalar) expected = checksum;
+         if (checksum != expected) {
+            std::cerr << kernel.name << " returned wrong results" << std::endl;
+            return EXIT_FAILURE;
+         }
+         double ns = std::chrono::duration<double, std::nano>(end - start).count() / lookupsPerRun;
+         std::cout << std::setw(12) << std::fixed << std::setprecision(2) << ns;
+      }
+      std::cout << std::endl;
+   }
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "OLC_BTree.hpp"
+#include "PrefixNodes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// -------------------------------------------------------------------------------------
+// Compares the packed and the prefix compressed node formats. The keys carry a tenant in
+// the upper 16 bits and a timestamp like counter below, they are inserted once in order
+// and once shuffled. Uniformly random keys show the overhead when there is no prefix.
+// -------------------------------------------------------------------------------------
+
+template <class Fn>
+static double seconds(Fn&& fn) {
+   auto start = std::chrono::steady_clock::now();
+   fn();
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Nodes>
+static void run(const char* name, const std::vector<Key>& keys) {
+   OLC_BTree<Key, Payload, OptLatch, Nodes> tree;
+   double upsert = seconds([&]() {
+      for (Key k : keys) tree.upsert(k, k);
+   });
+   uint64_t missing = 0;
+   double lookup = seconds([&]() {
+      Payload result = 0;
+      for (Key k : keys) {
+         if (!tree.lookup(k, result)) ++missing;
+      }
+   });
+   if (missing > 0) std::cerr << name << " lost " << missing << " keys" << std::endl;
+   std::cout << "  " << name << " height " << tree.getHeight() << ", upsert " << keys.size() / upsert / 1e6
+             << " M ops/s, lookup " << keys.size() / lookup / 1e6 << " M ops/s" << std::endl;
+}
+
+static void compare(const char* workload, const std::vector<Key>& keys) {
+   std::cout << workload << ", " << keys.size() << " keys" << std::endl;
+   run<PackedNodes>("packed", keys);
+   run<PrefixNodes>("prefix", keys);
+}
+
+int main(int argc, char** argv) {
+   uint64_t n = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10'000'000;
+   unsigned tenants = (argc > 2) ? std::atoi(argv[2]) : 16;
+
+   std::vector<Key> keys(n);
+   for (uint64_t i = 0; i < n; ++i) keys[i] = (static_cast<Key>(i % tenants) << 48) | (i / tenants);
+   std::sort(keys.begin(), keys.end());
+   compare("clustered keys in order", keys);
+   std::shuffle(keys.begin(), keys.end(), std::mt19937_64(42));
+   compare("clustered keys shuffled", keys);
+
+   std::mt19937_64 rng(42);
+   for (Key& k : keys) k = rng();
+   compare("uniform keys", keys);
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ThreadRegistry.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+// -------------------------------------------------------------------------------------
+// Counts the restarts of optimistic tree operations. Every thread only writes its own
+// counters, so counting does not add contention, stats() sums them up on demand.
+// -------------------------------------------------------------------------------------
+
+enum class TreeOperation : uint8_t { Upsert, Lookup, Remove, Scan };
+
+enum class RestartCause : uint8_t {
+   Locked,         // a writer held the latch
+   VersionChanged, // a writer modified the node since it was read
+   Obsolete        // the node was merged away
+};
+
+struct ContentionStats {
+   static constexpr unsigned operations = 4;
+   static constexpr unsigned causes = 3;
+   static constexpr unsigned maxLevels = 16; // deeper levels are counted in the last one
+
+   uint64_t restarts[operations][causes] = {};
+   uint64_t restartsByLevel[operations][maxLevels] = {}; // level 0 is the root
+   uint64_t sharedFallbacks[operations] = {}; // operations that gave up and latched in shared mode
+
+   uint64_t total(TreeOperation op) const {
+      uint64_t sum = 0;
+      for (unsigned cause = 0; cause < causes; ++cause) sum += restarts[static_cast<unsigned>(op)][cause];
+      return sum;
+   }
+   uint64_t total(RestartCause cause) const {
+      uint64_t sum = 0;
+      for (unsigned op = 0; op < operations; ++op) sum += restarts[op][static_cast<unsigned>(cause)];
+      return sum;
+   }
+   uint64_t total() const {
+      uint64_t sum = 0;
+      for (unsigned op = 0; op < operations; ++op) sum += total(static_cast<TreeOperation>(op));
+      return sum;
+   }
+};
+
+class ContentionCounters {
+  public:
+   ContentionCounters();
+   ContentionCounters(const ContentionCounters&) = delete;
+   ContentionCounters& operator=(const ContentionCounters&) = delete;
+
+   void count(TreeOperation op, unsigned level, RestartCause cause) {
+      ThreadCounters& counters = threads[threadId()];
+      unsigned o = static_cast<unsigned>(op);
+      increment(counters.restarts[o][static_cast<unsigned>(cause)]);
+      increment(counters.restartsByLevel[o][(level < ContentionStats::maxLevels) ? level : ContentionStats::maxLevels - 1]);
+   }
+
+   void countFallback(TreeOperation op) {
+      increment(threads[threadId()].sharedFallbacks[static_cast<unsigned>(op)]);
+   }
+
+   // Restarts of operations running concurrently may or may not be included.
+   ContentionStats collect() const;
+   // Must not run concurrently with count.
+   void reset();
+
+  private:
+   struct alignas(64) ThreadCounters {
+      std::atomic<uint64_t> restarts[ContentionStats::operations][ContentionStats::causes] = {};
+      std::atomic<uint64_t> restartsByLevel[ContentionStats::operations][ContentionStats::maxLevels] = {};
+      std::atomic<uint64_t> sharedFallbacks[ContentionStats::operations] = {};
+   };
+
+   // only the owning thread writes, so no atomic read-modify-write is needed
+   static void increment(std::atomic<uint64_t>& counter) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+   }
+
+   std::unique_ptr<ThreadCounters[]> threads;
+};
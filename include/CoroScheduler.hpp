@@ -0,0 +1,62 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+// -------------------------------------------------------------------------------------
+// Minimal single-threaded coroutine runtime to overlap the cache misses of independent
+// tree operations. Operations suspend after prefetching the next node and the scheduler
+// resumes the other in-flight operations round robin in the meantime.
+// -------------------------------------------------------------------------------------
+
+class CoroTask {
+  public:
+   struct promise_type {
+      CoroTask get_return_object() { return CoroTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      std::suspend_always final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+   };
+
+   CoroTask(CoroTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+   CoroTask(const CoroTask&) = delete;
+   CoroTask& operator=(const CoroTask&) = delete;
+   ~CoroTask() {
+      if (handle) handle.destroy();
+   }
+
+   // Hands the coroutine over to the caller, who has to destroy it.
+   std::coroutine_handle<> release() {
+      std::coroutine_handle<> released = handle;
+      handle = nullptr;
+      return released;
+   }
+
+  private:
+   explicit CoroTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+   std::coroutine_handle<promise_type> handle;
+};
+
+// Operations yield to the scheduler with co_await CoroYield{}.
+using CoroYield = std::suspend_always;
+
+// -------------------------------------------------------------------------------------
+class CoroScheduler {
+  public:
+   // At most maxInFlight operations are interleaved, the rest waits in spawn order.
+   explicit CoroScheduler(size_t maxInFlight = 16) : maxInFlight(maxInFlight) {}
+   ~CoroScheduler();
+   CoroScheduler(const CoroScheduler&) = delete;
+   CoroScheduler& operator=(const CoroScheduler&) = delete;
+
+   void spawn(CoroTask task) { pending.push_back(task.release()); }
+   // Runs until all spawned operations completed.
+   void run();
+
+  private:
+   size_t maxInFlight;
+   std::deque<std::coroutine_handle<>> pending;
+   std::deque<std::coroutine_handle<>> ready;
+};
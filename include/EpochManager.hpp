@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ThreadRegistry.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+// -------------------------------------------------------------------------------------
+// Epoch based reclamation for nodes that optimistic readers might still look at.
+// Operations enter an epoch before touching the tree and exit it afterwards. Unlinked
+// nodes are retired with the current global epoch and handed back to the reclaimer once
+// every thread that is inside an epoch entered after the node was retired.
+// -------------------------------------------------------------------------------------
+
+class EpochManager {
+  public:
+   using Reclaimer = void (*)(void* context, void* ptr);
+
+   EpochManager(Reclaimer reclaimer, void* context);
+   ~EpochManager(); // reclaims all deferred nodes, no thread may be inside an epoch
+   EpochManager(const EpochManager&) = delete;
+   EpochManager& operator=(const EpochManager&) = delete;
+
+   // Reentrant, only the outermost enter/exit pair publishes the epoch.
+   void enter() {
+      ThreadState& state = threads[threadId()];
+      if (state.depth++ == 0) {
+         // seq_cst, the store must be visible before we read any node pointer
+         state.epoch.store(globalEpoch.load());
+      }
+   }
+
+   void exit() {
+      ThreadState& state = threads[threadId()];
+      if (--state.depth == 0) {
+         state.epoch.store(idle, std::memory_order_release);
+      }
+   }
+
+   // ptr must already be unreachable for threads entering from now on.
+   void retire(void* ptr) { retire(ptr, reclaimer, context); }
+   // Same as above, but ptr is handed to the given reclaimer instead of the default one.
+   void retire(void* ptr, Reclaimer reclaimer, void* context);
+
+  private:
+   static constexpr uint64_t idle = UINT64_MAX;
+   static constexpr uint64_t reclaimBatch = 64;
+
+   struct Retired {
+      void* ptr;
+      uint64_t epoch;
+      Reclaimer reclaimer;
+      void* context;
+   };
+
+   struct alignas(64) ThreadState {
+      std::atomic<uint64_t> epoch{idle};
+      unsigned depth = 0;
+      std::vector<Retired> retired;
+   };
+
+   std::atomic<uint64_t> globalEpoch{0};
+   std::unique_ptr<ThreadState[]> threads;
+   Reclaimer reclaimer;
+   void* context;
+
+   uint64_t minActiveEpoch();
+   void reclaim(ThreadState& state);
+};
+
+// -------------------------------------------------------------------------------------
+class EpochGuard {
+   EpochManager& manager;
+
+  public:
+   explicit EpochGuard(EpochManager& manager) : manager(manager) { manager.enter(); }
+   ~EpochGuard() { manager.exit(); }
+   EpochGuard(const EpochGuard&) = delete;
+   EpochGuard& operator=(const EpochGuard&) = delete;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "OLC_BTree.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+// -------------------------------------------------------------------------------------
+// Leaves for insert heavy workloads after the FPTree. New entries are appended instead of
+// shifting the entries behind them, a one byte hash of every key (its fingerprint) is
+// compared with SIMD first, so a lookup only compares the keys of the matching entries.
+// The entries are sorted when a leaf splits or rebalances and when a scan reaches it. Leaves
+// that were filled in key order, by appends or a bulk load, stay sorted.
+// -------------------------------------------------------------------------------------
+
+// Same interface as BTreeLeaf.
+template <class Key = ::Key, class Payload = ::Payload, class Latch = OptLatch>
+struct FingerprintLeaf : public BTreeLeafBase<Latch> {
+   static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Payload>);
+   using NodeBase = ::NodeBase<Latch>;
+   using BTreeLeafBase<Latch>::count;
+   using BTreeLeafBase<Latch>::type;
+   using BTreeLeafBase<Latch>::typeMarker;
+   // -------------------------------------------------------------------------------------
+   static constexpr uint64_t payloadSize=std::is_empty_v<Payload> ? 0 : sizeof(Payload);
+   // 16 bytes for the sorted count and the padding of the fingerprints
+   static constexpr uint64_t maxEntries=(pageSize-sizeof(NodeBase)-sizeof(FingerprintLeaf*)-16)/(1+sizeof(Key)+payloadSize);
+   static_assert(maxEntries <= UINT16_MAX);
+   FingerprintLeaf* next; // right sibling, used by range scans
+   uint16_t sorted; // the entries [0, sorted) are in key order
+   uint8_t fingerprints[(maxEntries+15)/16*16]; // padded for findByte
+   Key keys[maxEntries];
+   [[no_unique_address]] PayloadArray<Payload, maxEntries> payloads;
+   // -------------------------------------------------------------------------------------
+   FingerprintLeaf() {
+      static_assert(sizeof(FingerprintLeaf) <= pageSize);
+      count=0;
+      type=typeMarker;
+      next=nullptr;
+      sorted=0;
+   }
+   // -------------------------------------------------------------------------------------
+   // Optimistic readers can see any count, positions below it stay inside the arrays.
+   unsigned entryCount() const { return std::min<unsigned>(count, maxEntries); }
+   bool isFull() { return count==maxEntries; };
+   bool isUnderfull() { return count<maxEntries/4; };
+   bool canInsert(Key) { return !isFull(); } // false if a new key needs a split first
+   bool canMerge(FingerprintLeaf* right) { return count+right->count<=maxEntries; }
+   bool find(Key k,Payload& p); // sets p if k exists
+   bool contains(Key k);
+   void insert(Key k,Payload p); // inserts k or updates its payload if k already exists
+   bool remove(Key k); // false if k does not exist, the last entry moves into the gap
+   FingerprintLeaf* split(Key& sep, NodeArena& arena); // moves the upper half into a new leaf, sep is the shortestSeparator between them
+   void merge(FingerprintLeaf* right); // appends all entries of the right sibling, caller checks canMerge
+   Key rebalance(FingerprintLeaf* right); // evens out the entries with the right sibling, returns the new separator
+   void load(const Key* keys,const Payload* payloads,unsigned n,const Key* lowerFence,const Key* upperFence);
+   // Sorts a copy of the entries if the leaf is unsorted, optimistic readers cannot sort it.
+   unsigned copyEntries(Key from,bool exclusive,uint64_t limit,Key* keysOut,Payload* payloadsOut);
+   bool isSorted() { return sorted>=count; }
+   void sortEntries(); // writers only
+
+  private:
+   static uint8_t fingerprint(const Key& k) {
+      // multiplicative hash of the key in 8 byte words, the fingerprint is the top byte
+      auto bytes = reinterpret_cast<const char*>(&k);
+      uint64_t hash = 0;
+      for (size_t i = 0; i < sizeof(Key); i += sizeof(uint64_t)) {
+         uint64_t word = 0;
+         std::memcpy(&word, bytes + i, std::min(sizeof(Key) - i, sizeof(word)));
+         hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+      }
+      return hash >> 56;
+   }
+   unsigned position(Key k); // of the entry with key k, entryCount() if there is none
+   // Copies the n entries of from, which may be this leaf, at pos to position to.
+   void moveEntries(unsigned to, FingerprintLeaf* from, unsigned pos, unsigned n);
+};
+
+// -------------------------------------------------------------------------------------
+// OLC_BTree<Key, Payload, Latch, FingerprintNodes> uses fingerprinted leaves and the packed
+// inner nodes.
+struct FingerprintNodes {
+   template <class Key, class Payload, class Latch>
+   using Leaf = FingerprintLeaf<Key, Payload, Latch>;
+   template <class Key, class Latch>
+   using Inner = BTreeInner<Key, Latch>;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "OLC_BTree.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+// -------------------------------------------------------------------------------------
+// Leaves with gaps between their entries, so an insert only shifts the entries up to the
+// nearest gap instead of all larger ones. A bitmap marks the slots that hold an entry.
+// The keys of all slots in use are in ascending order, a gap keeps a key between its
+// neighbours (the one of a removed entry or a copy of the next entry), so lookups search
+// all slots with the SIMD kernels of NodeSearch.hpp and take the next occupied slot.
+// Splits, merges and bulk loads spread the entries evenly over the slots.
+// -------------------------------------------------------------------------------------
+
+// Same interface as BTreeLeaf.
+template <class Key = ::Key, class Payload = ::Payload, class Latch = OptLatch>
+struct GappedLeaf : public BTreeLeafBase<Latch> {
+   static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Payload>);
+   using NodeBase = ::NodeBase<Latch>;
+   using BTreeLeafBase<Latch>::count;
+   using BTreeLeafBase<Latch>::type;
+   using BTreeLeafBase<Latch>::typeMarker;
+   // -------------------------------------------------------------------------------------
+   static constexpr uint64_t payloadSize=std::is_empty_v<Payload> ? 0 : sizeof(Payload);
+   static constexpr uint64_t bitmapWords=(pageSize/(sizeof(Key)+payloadSize)+63)/64;
+   // slots, a full leaf has no gaps left
+   static constexpr uint64_t maxEntries=(pageSize-sizeof(NodeBase)-sizeof(GappedLeaf*)-sizeof(uint64_t)-bitmapWords*sizeof(uint64_t))/(sizeof(Key)+payloadSize);
+   static_assert(maxEntries <= UINT16_MAX);
+   GappedLeaf* next; // right sibling, used by range scans
+   uint16_t end; // the slots [0, end) are in use, the ones behind are free
+   uint64_t occupied[bitmapWords];
+   Key keys[maxEntries];
+   [[no_unique_address]] PayloadArray<Payload, maxEntries> payloads;
+   // -------------------------------------------------------------------------------------
+   GappedLeaf() {
+      static_assert(sizeof(GappedLeaf) <= pageSize);
+      count=0;
+      type=typeMarker;
+      next=nullptr;
+      end=0;
+      std::fill(occupied, occupied+bitmapWords, 0);
+   }
+   // -------------------------------------------------------------------------------------
+   // Optimistic readers can see any end, slots below it stay inside the arrays.
+   unsigned usedSlots() const { return std::min<unsigned>(end, maxEntries); }
+   bool isFull() { return count==maxEntries; };
+   bool isUnderfull() { return count<maxEntries/4; };
+   bool canInsert(Key) { return !isFull(); } // false if a new key needs a split first
+   bool canMerge(GappedLeaf* right) { return count+right->count<=maxEntries; }
+   bool find(Key k,Payload& p); // sets p if k exists
+   bool contains(Key k);
+   void insert(Key k,Payload p); // inserts k or updates its payload if k already exists
+   bool remove(Key k); // false if k does not exist, its slot becomes a gap
+   GappedLeaf* split(Key& sep, NodeArena& arena); // moves the upper half into a new leaf, sep is the shortestSeparator between them
+   void merge(GappedLeaf* right); // takes all entries of the right sibling, caller checks canMerge
+   Key rebalance(GappedLeaf* right); // evens out the entries with the right sibling, returns the new separator
+   void load(const Key* keys,const Payload* payloads,unsigned n,const Key* lowerFence,const Key* upperFence);
+   unsigned copyEntries(Key from,bool exclusive,uint64_t limit,Key* keysOut,Payload* payloadsOut);
+   bool isSorted() { return true; }
+   void sortEntries() {}
+
+  private:
+   bool isOccupied(unsigned slot) const { return (occupied[slot/64]>>(slot%64))&1; }
+   void setOccupied(unsigned slot) { occupied[slot/64]|=uint64_t(1)<<(slot%64); }
+   // First slot >= pos and last slot < pos that is occupied (free if !used), maxEntries if
+   // there is none.
+   unsigned nextSlot(unsigned pos, bool used) const;
+   unsigned previousSlot(unsigned pos, bool used) const;
+   unsigned position(Key k); // slot of the entry with key k, usedSlots() if there is none
+   // Copies all entries in key order and returns their number.
+   unsigned gather(Key* keysOut, Payload* payloadsOut);
+   // Replaces all entries by the n ascending ones, spread evenly over the slots.
+   // payloadsIn may be nullptr for empty payload types.
+   void spread(const Key* keysIn, const Payload* payloadsIn, unsigned n);
+};
+
+// -------------------------------------------------------------------------------------
+// OLC_BTree<Key, Payload, Latch, GappedNodes> uses gapped leaves and the packed inner nodes.
+struct GappedNodes {
+   template <class Key, class Payload, class Latch>
+   using Leaf = GappedLeaf<Key, Payload, Latch>;
+   template <class Key, class Latch>
+   using Inner = BTreeInner<Key, Latch>;
+};
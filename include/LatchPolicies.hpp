@@ -0,0 +1,127 @@
+#pragma once
+
+#include "OptLatch.hpp"
+#include <atomic>
+#include <cstdint>
+// -------------------------------------------------------------------------------------
+// Alternatives to OptLatch for OLC_BTree. They implement the same interface, so the tree
+// code is shared, versions returned by the read functions are only meaningful for
+// isLocked/isObsolete.
+// -------------------------------------------------------------------------------------
+
+// Pessimistic reader-writer latch, the read functions take a real shared latch. Readers
+// block while a writer holds the latch, writers never block but restart if the latch is
+// taken, so there are no deadlocks. Shared latches that the tree code drops without a
+// matching readUnlockOrRestart are released by releaseReadLatches after every attempt.
+struct RWLatch {
+   static constexpr bool pessimistic = true;
+   static constexpr uint64_t obsoleteBit = 0b1;
+   static constexpr uint64_t exclusiveBit = 0b10;
+   static constexpr uint64_t sharedUnit = 0b100; // the number of shared holders is counted above the flags
+
+   std::atomic<uint64_t> latchVersion{0};
+
+   bool isLocked(uint64_t version) { return (version & exclusiveBit) != 0; }
+   bool isObsolete(uint64_t version) { return (version & obsoleteBit) != 0; }
+   uint64_t currentVersion() const { return latchVersion.load(); }
+
+   uint64_t readLockOrRestart(bool& needRestart) {
+      uint64_t version = latchVersion.load();
+      while (true) {
+         if (isObsolete(version)) {
+            needRestart = true;
+            return version;
+         }
+         if (isLocked(version)) {
+            Backoff::pause();
+            version = latchVersion.load();
+            continue;
+         }
+         if (latchVersion.compare_exchange_weak(version, version + sharedUnit)) {
+            held[heldCount++] = this;
+            return version + sharedUnit;
+         }
+      }
+   }
+
+   void readUnlockOrRestart(uint64_t, bool& needRestart) {
+      needRestart = false;
+      latchVersion.fetch_sub(sharedUnit);
+      forget();
+   }
+
+   void checkOrRestart(uint64_t, bool& needRestart) const { needRestart = false; }
+
+   // Only the sole shared holder can upgrade, two readers waiting for each other to
+   // leave would deadlock.
+   void upgradeToWriteLockOrRestart(uint64_t&, bool& needRestart) {
+      uint64_t expected = sharedUnit;
+      if (latchVersion.compare_exchange_strong(expected, exclusiveBit)) {
+         forget();
+      } else {
+         needRestart = true;
+      }
+   }
+
+   void upgradeToWriteLockNoWaitOrRestart(uint64_t& version, bool& needRestart) {
+      upgradeToWriteLockOrRestart(version, needRestart);
+   }
+
+   void writeLockOrRestart(bool& needRestart) {
+      uint64_t expected = 0;
+      if (!latchVersion.compare_exchange_strong(expected, exclusiveBit)) needRestart = true;
+   }
+
+   void writeUnlock() { latchVersion.store(0); }
+   void writeUnlockObsolete() { latchVersion.store(obsoleteBit); }
+
+   // Shared latch for lock coupling, it is not released by releaseReadLatches.
+   bool tryLockShared() {
+      uint64_t version = latchVersion.load();
+      if (isLocked(version) || isObsolete(version)) return false;
+      return latchVersion.compare_exchange_strong(version, version + sharedUnit);
+   }
+
+   void unlockShared() { latchVersion.fetch_sub(sharedUnit); }
+
+   static void releaseReadLatches() {
+      for (unsigned i = 0; i < heldCount; ++i) held[i]->latchVersion.fetch_sub(sharedUnit);
+      heldCount = 0;
+   }
+
+  private:
+   // a descent holds at most a node, its parent and the node it started from
+   static constexpr unsigned maxHeld = 8;
+   static inline thread_local RWLatch* held[maxHeld];
+   static inline thread_local unsigned heldCount = 0;
+
+   void forget() {
+      for (unsigned i = 0; i < heldCount; ++i) {
+         if (held[i] == this) {
+            held[i] = held[--heldCount];
+            return;
+         }
+      }
+   }
+};
+
+// No latching at all for single-threaded phases like an initial load. Every operation
+// succeeds in its first attempt.
+struct NoLatch {
+   static constexpr bool pessimistic = false;
+
+   bool isLocked(uint64_t) { return false; }
+   bool isObsolete(uint64_t) { return false; }
+   uint64_t currentVersion() const { return 0; }
+   uint64_t readLockOrRestart(bool&) { return 0; }
+   void readUnlockOrRestart(uint64_t, bool& needRestart) const { needRestart = false; }
+   void checkOrRestart(uint64_t, bool& needRestart) const { needRestart = false; }
+   void upgradeToWriteLockOrRestart(uint64_t&, bool&) {}
+   void upgradeToWriteLockNoWaitOrRestart(uint64_t&, bool&) {}
+   void writeLockOrRestart(bool&) {}
+   void writeUnlock() {}
+   void writeUnlockObsolete() {}
+   bool tryLockShared() { return true; }
+   void unlockShared() {}
+   static void releaseReadLatches() {}
+};
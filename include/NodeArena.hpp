@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ThreadRegistry.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+// -------------------------------------------------------------------------------------
+// Hands out page aligned nodes of a fixed size from large chunks. Every thread allocates
+// from and frees into its own cache, only refilling and flushing a batch of nodes goes
+// through the shared free list, so splits do not serialize on the allocator.
+// Memory is only returned to the system when the arena is destroyed.
+// Every node also has a 32 bit id, which is the index of its chunk in a process wide chunk
+// directory times the nodes per chunk plus the position of the node in the chunk. Chunks
+// are chunkSize aligned and their first page holds the index, it is never handed out as a
+// node, so 0 is not the id of any node. Ids do not depend on where a chunk is mapped.
+// -------------------------------------------------------------------------------------
+
+enum class NodeAllocMode : uint8_t {
+   Default,  // chunks from the regular heap
+   HugePages // chunks are 2MB huge pages, MAP_HUGETLB or transparent huge pages as fallback
+};
+
+// Where the chunks are placed on multi-socket machines, ignored without NUMA support.
+enum class NumaPlacement : uint8_t {
+   Default,    // first touch
+   Interleave, // the pages of every chunk are interleaved over all NUMA nodes
+   Local,      // nodes come from chunks on the NUMA node of the allocating thread
+   Bind        // all chunks are placed on the NUMA node passed to the constructor
+};
+
+class NodeArena {
+  public:
+   static constexpr size_t nodeSize = 4 * 1024;
+   static constexpr size_t chunkSize = 2 * 1024 * 1024;
+   static constexpr size_t nodesPerChunk = chunkSize / nodeSize;
+   static constexpr size_t maxChunks = (size_t(1) << 32) / nodesPerChunk;
+
+   explicit NodeArena(NodeAllocMode mode = NodeAllocMode::Default, NumaPlacement placement = NumaPlacement::Default,
+                      unsigned bindNode = 0);
+   ~NodeArena();
+   NodeArena(const NodeArena&) = delete;
+   NodeArena& operator=(const NodeArena&) = delete;
+
+   void* allocate() {
+      ThreadCache& cache = caches[threadId()];
+      if (!cache.head) refill(cache);
+      FreeNode* node = cache.head;
+      cache.head = node->next;
+      --cache.count;
+      return node;
+   }
+
+   void free(void* ptr) {
+      ThreadCache& cache = caches[threadId()];
+      auto node = static_cast<FreeNode*>(ptr);
+      node->next = cache.head;
+      cache.head = node;
+      if (++cache.count >= 2 * batchSize) flush(cache);
+   }
+
+   // Id of a node of any arena, 0 for nullptr.
+   static uint32_t idOf(const void* node) {
+      if (!node) return 0;
+      auto address = reinterpret_cast<uintptr_t>(node);
+      auto header = reinterpret_cast<const ChunkHeader*>(address & ~(chunkSize - 1));
+      return header->index * nodesPerChunk + (address & (chunkSize - 1)) / nodeSize;
+   }
+   // Optimistic readers can pass any id, unknown ones give nullptr or a page they have to validate.
+   static void* nodeOf(uint32_t id) {
+      char* chunk = chunkDirectory[id / nodesPerChunk].load(std::memory_order_relaxed);
+      return chunk ? chunk + (id % nodesPerChunk) * nodeSize : nullptr;
+   }
+
+   // 1 without NUMA support.
+   static unsigned numaNodes();
+   // NUMA node of the CPU the calling thread currently runs on, 0 without NUMA support.
+   static unsigned currentNumaNode();
+
+  private:
+   static constexpr size_t batchSize = 32;
+
+   struct FreeNode {
+      FreeNode* next;
+   };
+
+   struct alignas(64) ThreadCache {
+      FreeNode* head = nullptr;
+      size_t count = 0;
+   };
+
+   struct Chunk {
+      void* mapping;
+      size_t size; // 0 for chunks from the heap
+      uint32_t index; // in the chunk directory
+   };
+
+   // first page of every chunk
+   struct ChunkHeader {
+      uint32_t index;
+   };
+
+   // Free nodes and the chunk we are carving from, one pool per NUMA node for local placement.
+   struct Pool {
+      std::vector<FreeNode*> freeNodes;
+      char* chunkPos = nullptr;
+      char* chunkEnd = nullptr;
+   };
+
+   NodeAllocMode mode;
+   NumaPlacement placement;
+   unsigned bindNode;
+   std::unique_ptr<ThreadCache[]> caches;
+   std::mutex mutex; // protects everything below
+   std::vector<Chunk> chunks;
+   std::vector<Pool> pools;
+
+   // Index 0 stays empty, so nodeOf(0) is nullptr. Indexes of destroyed arenas are reused.
+   static std::atomic<char*> chunkDirectory[maxChunks];
+   static std::mutex directoryMutex; // protects the two below and the directory updates
+   static std::vector<uint32_t> freeChunkIndexes;
+   static uint32_t nextChunkIndex;
+
+   Pool& currentPool(unsigned& numaNode);
+   // Returns the chunk after its header page.
+   char* allocateChunk(unsigned numaNode);
+   void registerChunk(char* chunk, Chunk& entry);
+   void refill(ThreadCache& cache);
+   void flush(ThreadCache& cache);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+// -------------------------------------------------------------------------------------
+// Search kernels for the sorted key arrays of the btree nodes.
+// All kernels return the index of the first key >= k in keys[0..count).
+// -------------------------------------------------------------------------------------
+
+using LowerBoundFn = unsigned (*)(const uint64_t* keys, unsigned count, uint64_t k);
+
+unsigned lowerBoundScalar(const uint64_t* keys, unsigned count, uint64_t k);
+unsigned lowerBoundSSE(const uint64_t* keys, unsigned count, uint64_t k);
+unsigned lowerBoundAVX2(const uint64_t* keys, unsigned count, uint64_t k);
+unsigned lowerBoundAVX512(const uint64_t* keys, unsigned count, uint64_t k);
+
+// Best kernel supported by the cpu we are running on, selected once at startup.
+extern const LowerBoundFn lowerBoundKernel;
+const char* lowerBoundKernelName();
+
+inline unsigned lowerBound(const uint64_t* keys, unsigned count, uint64_t k) {
+   return lowerBoundKernel(keys, count, k);
+}
+
+// SSE2 kernels for 32 and 16 bit keys, like the keys of small trees or the suffixes of
+// prefix compressed nodes. SSE2 is part of x86-64, so they need no dispatch.
+unsigned lowerBound(const uint32_t* keys, unsigned count, uint32_t k);
+unsigned lowerBound(const uint16_t* keys, unsigned count, uint16_t k);
+
+// Index of the first byte == byte in bytes[from..count), count if there is none. SSE2,
+// bytes is read in aligned blocks of 16, so it has to be padded to a multiple of 16.
+unsigned findByte(const uint8_t* bytes, unsigned from, unsigned count, uint8_t byte);
+
+// Binary search for the other key types of the tree.
+template <class Key>
+inline unsigned lowerBound(const Key* keys, unsigned count, const Key& k) {
+   unsigned l = 0;
+   unsigned r = count;
+   while (l < r) {
+      unsigned mid = l + (r - l) / 2;
+      if (keys[mid] < k) {
+         l = mid + 1;
+      } else {
+         r = mid;
+      }
+   }
+   return l;
+}
@@ -1,91 +1,386 @@
 #pragma once
 
+#include "ContentionStats.hpp"
+#include "CoroScheduler.hpp"
+#include "EpochManager.hpp"
+#include "LatchPolicies.hpp"
+#include "NodeArena.hpp"
 #include "OptLatch.hpp"
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
 // -------------------------------------------------------------------------------------
 
+// Default key and payload types of the tree.
 using Key = uint64_t;
 using Payload = uint64_t;
 
-enum class NodeType : uint8_t { BTreeInner=1, BTreeLeaf=2 };
-static constexpr uint64_t pageSize=4*1024; // DO NOT CHANGE 4KB size nodes 
+// 16 byte key, ordered by high and then by low.
+struct Key128 {
+   uint64_t high;
+   uint64_t low;
+   friend auto operator<=>(const Key128&, const Key128&) = default;
+};
+
+// Payload type of trees that only store keys, the leaves reserve no space for it.
+struct NoPayload {};
 
-struct NodeBase : public OptLatch{
+enum class NodeType : uint8_t { BTreeInner=1, BTreeLeaf=2, BTreeInnerReplica=3 };
+static constexpr uint64_t pageSize=4*1024; // DO NOT CHANGE 4KB size nodes
+static_assert(pageSize == NodeArena::nodeSize);
+
+// The latch policy is OptLatch for optimistic lock coupling, see LatchPolicies.hpp for the
+// alternatives.
+template <class Latch>
+struct NodeBase : public Latch{
    NodeType type;
    uint16_t count;
 };
+static_assert(sizeof(NodeBase<OptLatch>) == 16);
+
+// 4 byte reference to a node, see NodeArena::idOf. Converts from and to pointers, so it
+// can replace them in the child array of an inner node.
+template <class Node>
+struct NodeId {
+   uint32_t id;
+   NodeId() = default;
+   NodeId(Node* node) : id(NodeArena::idOf(node)) {}
+   operator Node*() const { return static_cast<Node*>(NodeArena::nodeOf(id)); }
+};
 
-struct BTreeLeafBase : public NodeBase {
+template <class Latch>
+struct BTreeLeafBase : public NodeBase<Latch> {
    static const NodeType typeMarker=NodeType::BTreeLeaf;
 };
 
-struct BTreeInnerBase : public NodeBase {
+template <class Latch>
+struct BTreeInnerBase : public NodeBase<Latch> {
    static const NodeType typeMarker=NodeType::BTreeInner;
 };
 
-struct BTreeLeaf : public BTreeLeafBase {
-   // -------------------------------------------------------------------------------------
-   struct Entry {
-      Key k;
-      Payload p;
-   };
+// Payload array of a leaf, positions are indexes into the array.
+template <class Payload, uint64_t size, bool empty = std::is_empty_v<Payload>>
+struct PayloadArray {
+   Payload values[size];
+   Payload& operator[](uint64_t pos) { return values[pos]; }
+   void move(uint64_t to, uint64_t from, uint64_t n) { std::memmove(values + to, values + from, sizeof(Payload) * n); }
+   void copy(uint64_t to, const PayloadArray& other, uint64_t from, uint64_t n) {
+      std::memcpy(values + to, other.values + from, sizeof(Payload) * n);
+   }
+   void load(uint64_t to, const Payload* in, uint64_t n) { std::memcpy(values + to, in, sizeof(Payload) * n); }
+   void store(uint64_t from, Payload* out, uint64_t n) const { std::memcpy(out, values + from, sizeof(Payload) * n); }
+};
+
+// Empty payloads are not stored at all, every position refers to the same empty object.
+template <class Payload, uint64_t size>
+struct PayloadArray<Payload, size, true> : public Payload {
+   Payload& operator[](uint64_t) { return *this; }
+   void move(uint64_t, uint64_t, uint64_t) {}
+   void copy(uint64_t, const PayloadArray&, uint64_t, uint64_t) {}
+   void load(uint64_t, const Payload*, uint64_t) {}
+   void store(uint64_t, Payload*, uint64_t) const {}
+};
+
+// Separator for a split between the adjacent keys left < right, any s with left <= s < right
+// routes both correctly. Integer separators end in as many one bits as possible, so the
+// lower fence s+1 of the right node ends in zeros and prefix compressed inner nodes (see
+// PrefixNodes.hpp) get ranges that share more high bits.
+template <class Key>
+Key shortestSeparator(const Key& left, const Key& right) {
+   if constexpr (std::is_unsigned_v<Key>) {
+      // clear the bits of right below the highest bit in which it differs from left
+      Key highest = std::bit_floor(static_cast<Key>(left ^ right));
+      return static_cast<Key>((right & ~(highest - 1)) - 1);
+   } else {
+      return left;
+   }
+}
+
+// The node functions below do not latch, the caller has to hold the write latch
+// (or read optimistically and validate afterwards).
+// Keys and payloads are copied with memcpy, the fanout follows from their sizes.
+// The tree only uses the public functions of the leaf and the inner node below, other node
+// formats (see PackedNodes) have to provide the same ones.
+template <class Key = ::Key, class Payload = ::Payload, class Latch = OptLatch>
+struct BTreeLeaf : public BTreeLeafBase<Latch> {
+   static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<Payload>);
+   using NodeBase = ::NodeBase<Latch>;
+   using BTreeLeafBase<Latch>::count;
+   using BTreeLeafBase<Latch>::type;
+   using BTreeLeafBase<Latch>::typeMarker;
    // -------------------------------------------------------------------------------------
-   static constexpr uint64_t maxEntries=(pageSize-sizeof(NodeBase))/(sizeof(Key)+sizeof(Payload));
+   static constexpr uint64_t payloadSize=std::is_empty_v<Payload> ? 0 : sizeof(Payload);
+   static constexpr uint64_t maxEntries=(pageSize-sizeof(NodeBase)-sizeof(BTreeLeaf*))/(sizeof(Key)+payloadSize);
+   static_assert(maxEntries <= UINT16_MAX);
+   BTreeLeaf* next; // right sibling, used by range scans
    Key keys[maxEntries];
-   Payload payloads[maxEntries];
+   [[no_unique_address]] PayloadArray<Payload, maxEntries> payloads;
    // -------------------------------------------------------------------------------------
    BTreeLeaf() {
+      static_assert(sizeof(BTreeLeaf) <= pageSize);
       count=0;
       type=typeMarker;
+      next=nullptr;
    }
    // -------------------------------------------------------------------------------------
    bool isFull() { return count==maxEntries; };
-   unsigned lowerBound(Key k); // Implement
-   void insert(Key k,Payload p); // Implement
-   BTreeLeaf* split(Key& sep); // Implement 
-   void insertInLeaf(Key k, Payload p); 
-   void insertAndSplitIfNeeded(Key k, Payload p);
+   bool isUnderfull() { return count<maxEntries/4; };
+   bool canInsert(Key) { return !isFull(); } // false if a new key needs a split first
+   bool canMerge(BTreeLeaf* right) { return count+right->count<=maxEntries; }
+   unsigned lowerBound(Key k);
+   bool find(Key k,Payload& p); // sets p if k exists
+   bool contains(Key k);
+   void insert(Key k,Payload p); // inserts k or updates its payload if k already exists
+   bool remove(Key k); // false if k does not exist
+   BTreeLeaf* split(Key& sep, NodeArena& arena); // moves the upper half into a new leaf, sep is the shortestSeparator between them
+   void merge(BTreeLeaf* right); // appends all entries of the right sibling, caller checks canMerge
+   Key rebalance(BTreeLeaf* right); // evens out the entries with the right sibling, returns the new separator
+   // Fills the empty leaf with n ascending entries, payloads may be nullptr for empty payload
+   // types. The leaf covers the keys in (lowerFence, upperFence], nullptr means unbounded.
+   void load(const Key* keys,const Payload* payloads,unsigned n,const Key* lowerFence,const Key* upperFence);
+   // Copies up to limit entries with key >= from (> from if exclusive) in key order into the
+   // output buffers, payloadsOut may be nullptr. Returns the number of entries copied.
+   unsigned copyEntries(Key from,bool exclusive,uint64_t limit,Key* keysOut,Payload* payloadsOut);
+   // Leaves of other formats may keep their entries unsorted, scans sort them first.
+   bool isSorted() { return true; }
+   void sortEntries() {}
 };
 
 // -------------------------------------------------------------------------------------
-struct BTreeInner : public BTreeInnerBase {
-   static const uint64_t maxEntries=(pageSize-sizeof(NodeBase))/(sizeof(Key)+sizeof(NodeBase*));
-   NodeBase* children[maxEntries];
+// An inner node with count separators has count+1 children, children[i] holds all keys <= keys[i].
+// Child is the type of the entries of children, a pointer or a NodeId.
+template <class Key = ::Key, class Latch = OptLatch, class Child = NodeBase<Latch>*>
+struct BTreeInner : public BTreeInnerBase<Latch> {
+   using NodeBase = ::NodeBase<Latch>;
+   using BTreeInnerBase<Latch>::count;
+   using BTreeInnerBase<Latch>::type;
+   using BTreeInnerBase<Latch>::typeMarker;
+   static_assert(std::is_trivially_copyable_v<Child>);
+   static constexpr uint64_t maxEntries=(pageSize-sizeof(NodeBase))/(sizeof(Key)+sizeof(Child));
+   Child children[maxEntries];
    Key keys[maxEntries];
    // -------------------------------------------------------------------------------------
    BTreeInner() {
+      static_assert(sizeof(BTreeInner) <= pageSize);
       count=0;
       type=typeMarker;
    }
    // -------------------------------------------------------------------------------------
    bool isFull() { return count==(maxEntries-1); };
-   unsigned lowerBound(Key k); // implement 
-   BTreeInner* split(Key& sep); // implement
-   void insert(Key k,NodeBase* child); // implement
+   bool isUnderfull() { return count<maxEntries/4; };
+   bool canMerge(BTreeInner* right) { return static_cast<uint64_t>(count)+right->count+1<maxEntries-1; }
+   unsigned lowerBound(Key k);
+   NodeBase* childAt(unsigned pos) { return children[pos]; }
+   void setChildAt(unsigned pos,NodeBase* child) { children[pos]=child; }
+   Key keyAt(unsigned pos) { return keys[pos]; }
+   void setKeyAt(unsigned pos,Key k) { keys[pos]=k; } // k has to stay between its neighbours
+   BTreeInner* split(Key& sep, NodeArena& arena); // moves the upper half into a new node, sep is pushed up to the parent
+   void insert(Key k,NodeBase* child); // child becomes the right neighbour of the separator k
+   void removeAt(unsigned pos); // removes keys[pos] and its right child children[pos+1]
+   void merge(Key sep, BTreeInner* right); // sep is the separator between this node and right in the parent, caller checks canMerge
+   Key rebalance(Key sep, BTreeInner* right); // returns the new separator for the parent
+   // Fills the empty node with n children and the n-1 separators between them, the fences
+   // are the same as for BTreeLeaf::load.
+   void load(NodeBase* const* children,const Key* keys,unsigned n,const Key* lowerFence,const Key* upperFence);
+   void copyFrom(const BTreeInner& other); // copies all entries, the latch and the type stay
+};
+
+// -------------------------------------------------------------------------------------
+// Immutable copy of an inner node in a replica of the upper levels. It is never latched,
+// the children of the lowest replicated level are the nodes of the tree itself.
+template <class Inner>
+struct BTreeInnerReplica : public Inner {
+   static const NodeType typeMarker=NodeType::BTreeInnerReplica;
+   BTreeInnerReplica() {
+      this->type=typeMarker;
+   }
+};
+
+// -------------------------------------------------------------------------------------
+// Node formats of the tree, the default stores keys and payloads uncompressed. See
+// PrefixNodes.hpp for leaves and inner nodes that store the common prefix of their keys once
+// and FingerprintNodes.hpp and GappedNodes.hpp for leaves with cheaper inserts.
+struct PackedNodes {
+   template <class Key, class Payload, class Latch>
+   using Leaf = BTreeLeaf<Key, Payload, Latch>;
+   template <class Key, class Latch>
+   using Inner = BTreeInner<Key, Latch>;
+};
 
+// Same as PackedNodes, but inner nodes refer to their children by 4 byte NodeIds. With 8
+// byte keys they have a third more children, with 4 byte keys half more. A descent has
+// to look up each child in the chunk directory of NodeArena.
+struct CompactNodes {
+   template <class Key, class Payload, class Latch>
+   using Leaf = BTreeLeaf<Key, Payload, Latch>;
+   template <class Key, class Latch>
+   using Inner = BTreeInner<Key, Latch, NodeId<NodeBase<Latch>>>;
 };
 // -------------------------------------------------------------------------------------
 // -------------------------------------------------------------------------------------
-// BTREE 
+// BTREE
 // -------------------------------------------------------------------------------------
+// Node placement on multi-socket machines. Inner nodes are read by every thread, so they
+// are spread over all sockets, leaves are mostly touched by the thread inserting them.
+enum class NumaPolicy : uint8_t {
+   None,
+   InterleaveInner,
+   LocalLeaves,
+   InterleaveInnerLocalLeaves
+};
+
 // Implement upsert and lookup, do not change the function signature as we test against this
 // interface.
 // You do not need to store duplicate keys, we just update them in the upsert method.
-// All inputs key, and values, are uint64_t.
+// Keys and payloads are uint64_t unless the template arguments say otherwise.
 
+// Latch is OptLatch, RWLatch or NoLatch (see LatchPolicies.hpp), Nodes is PackedNodes,
+// CompactNodes, PrefixNodes, FingerprintNodes or GappedNodes. The implementation lives in OLC_BTree_Stencil.cpp, which instantiates the
+// supported combinations of the parameters.
+template <class Key = ::Key, class Payload = ::Payload, class Latch = OptLatch, class Nodes = PackedNodes>
 class OLC_BTree {
+   using NodeBase = ::NodeBase<Latch>;
+   using BTreeLeaf = typename Nodes::template Leaf<Key, Payload, Latch>;
+   using BTreeInner = typename Nodes::template Inner<Key, Latch>;
+   using BTreeInnerReplica = ::BTreeInnerReplica<BTreeInner>;
+
   private:
    std::atomic<NodeBase*> root;
    std::atomic<uint64_t> height;
-   // feel free to add variables      
-   void makeRoot(Key k,NodeBase* leftChild,NodeBase* rightChild); // implement
-   
-   public:
-   OLC_BTree() {
-      root = new BTreeLeaf();
+   // feel free to add variables
+   // all nodes live here, the arenas have to outlive the epoch manager
+   NodeArena innerArena;
+   NodeArena leafArena;
+   // One copy of the upper levels per NUMA node for lookups and scans. Changes of the
+   // replicated levels are serialized by replicaMutex, replicaVersion is odd while one is
+   // in progress and the replicas are rebuilt before it becomes even again.
+   unsigned replicatedLevels;
+   unsigned numReplicas = 0;
+   std::unique_ptr<std::atomic<NodeBase*>[]> replicaRoots; // nullptr if replication is off
+   std::vector<std::unique_ptr<NodeArena>> replicaArenas;
+   std::atomic<uint64_t> replicaVersion{0};
+   std::atomic<uint64_t> replicatedDepth{0}; // number of levels in the current replicas
+   std::mutex replicaMutex;
+   ContentionCounters contention;
+   BackoffPolicy backoffPolicy; // used by all retry loops
+   unsigned sharedFallbackAfter = 8;
+   EpochManager epochManager; // every public operation runs inside an epoch
+   void makeRoot(Key k,NodeBase* leftChild,NodeBase* rightChild);
+   // Write latches parent (if any) and node for a structure modification, false on restart.
+   bool lockParentAndNode(BTreeInner* parent, uint64_t& versionParent, NodeBase* node, uint64_t& versionNode, bool& needRestart);
+   // Same as lockParentAndNode, additionally fails if the replicated levels changed since
+   // versionReplica was read at the start of the descent. topLevel is set if the change
+   // touches the replicated levels, finishStructureChange has to be called once the
+   // latches are released.
+   bool lockStructureChange(BTreeInner* parent, uint64_t& versionParent, NodeBase* node, uint64_t& versionNode,
+                            unsigned depth, uint64_t versionReplica, bool& topLevel, bool& needRestart);
+   void finishStructureChange(bool topLevel);
+   void rebuildReplicas();
+   NodeBase* copyReplica(BTreeInner* master, uint64_t levels, NodeArena& arena);
+   void retireReplica(NodeBase* node, NodeArena& arena);
+   static void reclaimReplicaNode(void* arena, void* node);
+   // Descends the replica of the local NUMA node down to the first node of the tree
+   // itself and sets depth to its level, false if there is no replica to use.
+   bool descendReplica(Key k, NodeBase*& node, uint64_t& versionNode, unsigned& depth, bool& needRestart);
+   // A single optimistic attempt, returns false if the operation has to be retried.
+   // needRestart distinguishes conflicts from retries after a split.
+   bool tryUpsert(Key k, Payload v, bool& needRestart);
+   // Counts a conflict detected at the latch of node, the cause is taken from its current
+   // version. Always returns false, so attempts can end with return restartAt(...).
+   bool restartAt(TreeOperation op, unsigned level, NodeBase* node);
+   // Optimistically descends to the leaf responsible for k, the returned version of the
+   // leaf has to be validated by the caller. False on restart.
+   bool tryFindLeaf(TreeOperation op, Key k, BTreeLeaf*& leaf, uint64_t& versionLeaf);
+   BTreeLeaf* findLeaf(TreeOperation op, Key k, uint64_t& versionLeaf);
+   bool tryLookup(Key k, Payload& result, bool& found);
+   // Pessimistic lookup with shared latches, cannot be starved by writers.
+   bool lookupShared(Key k, Payload& result);
+   static void prefetchNode(NodeBase* node);
+   bool tryRemove(Key k, bool& found, bool& needRestart);
+   // Merge the underfull node at children[pos] of parent with a sibling or move entries
+   // over from it. mergeInner returns false if a latch could not be acquired. mergeLeaf
+   // is called with the leaf write latched, unlocks it and simply leaves it underfull if
+   // the other latches are not available.
+   bool mergeInner(BTreeInner* parent, uint64_t& versionParent, unsigned pos, BTreeInner* inner, uint64_t& versionNode,
+                   unsigned depth, uint64_t versionReplica);
+   void mergeLeaf(BTreeInner* parent, uint64_t versionParent, unsigned pos, BTreeLeaf* leaf, uint64_t versionReplica);
+   // Bottom-up construction, node i of a level gets the entries [i*n/nodes, (i+1)*n/nodes),
+   // so any range of nodes of a level can be built independently.
+   static uint64_t nodesForLevel(uint64_t entries, uint64_t perNode);
+   // First key of every leaf of a bulk load filled to fillFactor, followed by n. Leaves with a
+   // capacityForRange (see PrefixNodes.hpp) take as many keys as fit with the width they need.
+   static std::vector<uint64_t> leafBounds(const Key* keys, uint64_t n, double fillFactor);
+   void buildLeaves(const Key* keys, const Payload* payloads, uint64_t n, const std::vector<uint64_t>& bounds,
+                    uint64_t begin, uint64_t end, std::vector<NodeBase*>& level, std::vector<Key>& maxKeys);
+   void buildInnerLevel(const std::vector<NodeBase*>& children, const std::vector<Key>& childMaxKeys, uint64_t begin,
+                        uint64_t end, std::vector<NodeBase*>& level, std::vector<Key>& maxKeys);
+   template <class T>
+   T* newNode() {
+      NodeArena& arena = (T::typeMarker == NodeType::BTreeLeaf) ? leafArena : innerArena;
+      return new (arena.allocate()) T();
+   }
+   // Unlinked nodes are freed once no optimistic reader can still see them, the caller
+   // has to mark them obsolete first.
+   void retireNode(NodeBase* node) { epochManager.retire(node); }
+   static void reclaimNode(void* tree, void* node);
+   static NumaPlacement innerPlacement(NumaPolicy policy) {
+      bool interleave = (policy == NumaPolicy::InterleaveInner) || (policy == NumaPolicy::InterleaveInnerLocalLeaves);
+      return interleave ? NumaPlacement::Interleave : NumaPlacement::Default;
+   }
+   static NumaPlacement leafPlacement(NumaPolicy policy) {
+      bool local = (policy == NumaPolicy::LocalLeaves) || (policy == NumaPolicy::InterleaveInnerLocalLeaves);
+      return local ? NumaPlacement::Local : NumaPlacement::Default;
    }
+
+   public:
+   // HugePages backs the nodes with 2MB pages, which reduces TLB misses of large trees.
+   // The NUMA policy has no effect on machines without NUMA support.
+   // With replicatedLevels > 0 every NUMA node gets a copy of up to that many upper levels,
+   // the levels right above the leaves are never replicated. This speeds up lookups and
+   // scans of read-mostly trees, structure changes of the replicated levels become expensive.
+   explicit OLC_BTree(NodeAllocMode allocMode = NodeAllocMode::Default, NumaPolicy numaPolicy = NumaPolicy::None,
+                      unsigned replicatedLevels = 0);
+   OLC_BTree(const OLC_BTree&) = delete;
+   OLC_BTree& operator=(const OLC_BTree&) = delete;
    uint64_t getHeight(){return height;}
-   void upsert(Key k, Payload v); // implement upsert, i.e. insert or update if key exists
-   bool lookup(Key k, Payload& result); // implement lookup
-   void upsertInner(BTreeInner* innerNode, NodeBase* parent);
+   // For tests that latch nodes directly, splits of the root replace it.
+   ::NodeBase<Latch>* getRoot(){return root;}
+   void upsert(Key k, Payload v); // insert or update if key exists
+   bool lookup(Key k, Payload& result);
+   // Looks up n keys, found[i] tells whether out[i] was set. Groups of lookups descend the
+   // tree level by level and prefetch the next nodes of the whole group before using them.
+   // With a pessimistic latch the keys are looked up one by one.
+   void lookupBatch(const Key* keys, Payload* out, bool* found, size_t n);
+   // Coroutine versions for CoroScheduler, they suspend after prefetching each node. The
+   // result references have to stay valid until the scheduler ran the operation. With a
+   // pessimistic latch they do not suspend.
+   CoroTask lookupAsync(Key k, Payload& result, bool& found);
+   CoroTask upsertAsync(Key k, Payload v);
+   bool remove(Key k); // false if the key did not exist
+   // Builds the tree bottom-up from n strictly ascending keys, every node is filled to
+   // fillFactor. Must not run concurrently with other operations. If the tree is not
+   // empty the entries are upserted instead. payloads may be nullptr for empty payload types.
+   void bulkLoad(const Key* keys, const Payload* payloads, size_t n, double fillFactor = 1.0);
+   // Same as bulkLoad, the subtrees below the top levels are built by numThreads workers.
+   void bulkLoadParallel(const Key* keys, const Payload* payloads, size_t n, double fillFactor = 1.0,
+                         unsigned numThreads = std::thread::hardware_concurrency());
+   // Copies up to limit entries with key >= start in key order into the output buffers,
+   // returns the number of entries copied. payloadsOut may be nullptr if only the keys are needed.
+   uint64_t scan(Key start, uint64_t limit, Key* keysOut, Payload* payloadsOut);
+   // Restarts caused by latch conflicts since the tree was created or the last resetStats.
+   ContentionStats stats() const { return contention.collect(); }
+   void resetStats() { contention.reset(); }
+   // Must not be called concurrently with other operations.
+   void setBackoffPolicy(const BackoffPolicy& policy) { backoffPolicy = policy; }
+   // A lookup that restarted this many times descends again with shared latches, which
+   // bounds its latency when writers keep changing the nodes. 0 never falls back, lookups
+   // with a pessimistic latch never fall back either.
+   // Must not be called concurrently with other operations.
+   void setSharedFallback(unsigned restarts) { sharedFallbackAfter = restarts; }
 };
-
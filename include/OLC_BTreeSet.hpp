@@ -0,0 +1,34 @@
+#pragma once
+
+#include "OLC_BTree.hpp"
+// -------------------------------------------------------------------------------------
+// Set of keys on top of OLC_BTree. The leaves store no payloads, so they hold twice as many
+// 64-bit keys as the leaves of a tree with 64-bit payloads. Same concurrency guarantees as
+// OLC_BTree, the underlying tree is instantiated for uint32_t, uint64_t and Key128 keys.
+// With PrefixNodes (uint64_t keys only) narrow leaves hold up to four times as many keys.
+// -------------------------------------------------------------------------------------
+
+template <class Key = ::Key, class Latch = OptLatch, class Nodes = PackedNodes>
+class OLC_BTreeSet {
+  private:
+   OLC_BTree<Key, NoPayload, Latch, Nodes> tree;
+
+  public:
+   explicit OLC_BTreeSet(NodeAllocMode allocMode = NodeAllocMode::Default, NumaPolicy numaPolicy = NumaPolicy::None,
+                         unsigned replicatedLevels = 0)
+       : tree(allocMode, numaPolicy, replicatedLevels) {}
+   uint64_t getHeight() { return tree.getHeight(); }
+   void insert(Key k) { tree.upsert(k, NoPayload()); } // does nothing if k exists already
+   bool contains(Key k) {
+      NoPayload payload;
+      return tree.lookup(k, payload);
+   }
+   bool remove(Key k) { return tree.remove(k); } // false if the key did not exist
+   // Builds the set from n strictly ascending keys, see OLC_BTree::bulkLoad.
+   void bulkLoad(const Key* keys, size_t n, double fillFactor = 1.0) { tree.bulkLoad(keys, nullptr, n, fillFactor); }
+   // Copies up to limit keys >= start in ascending order into keysOut, returns the number
+   // of keys copied.
+   uint64_t scan(Key start, uint64_t limit, Key* keysOut) { return tree.scan(start, limit, keysOut, nullptr); }
+   ContentionStats stats() const { return tree.stats(); }
+   void resetStats() { tree.resetStats(); }
+};
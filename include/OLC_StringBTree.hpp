@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ContentionStats.hpp"
+#include "NodeArena.hpp"
+#include "OLC_BTree.hpp"
+#include "OptLatch.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+// -------------------------------------------------------------------------------------
+// Slotted page for the variable length keys of OLC_StringBTree, used by leaves and inner
+// nodes. The slot array grows from the front of the page, the entries (the key bytes
+// followed by a payload or a child pointer) grow from the back. Every slot keeps the
+// first bytes of its key as head, so most comparisons never touch the entries.
+// The node functions below do not latch, the caller has to hold the write latch
+// (or read optimistically and validate afterwards).
+// -------------------------------------------------------------------------------------
+struct StringNode : public NodeBase<OptLatch> {
+   struct Slot {
+      uint16_t offset; // of the entry in the page
+      uint16_t length; // of the key
+      uint32_t head;   // first 4 key bytes in big-endian order padded with zeros, compares like the key
+   };
+   static constexpr unsigned headerSize = 32;
+   static constexpr unsigned valueSize = sizeof(uint64_t);
+   static constexpr unsigned maxSlots = (pageSize - headerSize) / sizeof(Slot);
+
+   StringNode* link;   // right sibling of a leaf, rightmost child of an inner node
+   uint16_t heapStart; // the entries occupy [heapStart, pageSize)
+   uint16_t heapUsed;  // bytes of live entries, removed entries leave holes until the node is compacted
+   uint32_t reserved;
+   Slot slots[maxSlots]; // the entries overlay the unused end of the array
+
+   explicit StringNode(NodeType nodeType) {
+      count = 0;
+      type = nodeType;
+      link = nullptr;
+      heapStart = pageSize;
+      heapUsed = 0;
+   }
+   // -------------------------------------------------------------------------------------
+   static uint32_t head(std::string_view k);
+   static unsigned spaceNeeded(unsigned keyLength) { return sizeof(Slot) + keyLength + valueSize; }
+   bool isLeaf() const { return type == NodeType::BTreeLeaf; }
+   // Optimistic readers can see any count, positions beyond it stay inside the slot array.
+   unsigned slotCount() const { return (count < maxSlots) ? count : maxSlots; }
+   unsigned freeSpace() const { return heapStart - headerSize - count * sizeof(Slot); }
+   unsigned freeSpaceAfterCompaction() const { return pageSize - headerSize - count * sizeof(Slot) - heapUsed; }
+   bool canInsert(unsigned keyLength) const { return freeSpaceAfterCompaction() >= spaceNeeded(keyLength); }
+   // -------------------------------------------------------------------------------------
+   std::string_view keyAt(unsigned pos) const;
+   uint64_t valueAt(unsigned pos) const;
+   void setValueAt(unsigned pos, uint64_t value);
+   StringNode* childAt(unsigned pos) const { return (pos < slotCount()) ? reinterpret_cast<StringNode*>(valueAt(pos)) : link; }
+   void setChildAt(unsigned pos, StringNode* child);
+   int compare(unsigned pos, std::string_view k, uint32_t kHead) const;
+   unsigned lowerBound(std::string_view k, bool& found) const; // found is set if keyAt(pos) == k
+   // -------------------------------------------------------------------------------------
+   void insertAt(unsigned pos, std::string_view k, uint64_t value); // the caller checked canInsert
+   void removeAt(unsigned pos);
+   void insertSeparator(std::string_view sep, StringNode* right); // right becomes the child right of sep
+   void compact(); // moves all entries to the end of the page, so the holes become free space
+   // Both split by bytes, the caller checks that the parent has room for separator(splitPos())
+   // first. Leaves get the shortest separator between their halves, inner nodes push up a key.
+   unsigned splitPos() const;
+   std::string_view separator(unsigned pos) const;
+   StringNode* split(std::string& sep, NodeArena& arena);
+
+  private:
+   void copyEntries(StringNode* to, unsigned begin, unsigned end) const; // appends [begin, end) to the entries of to
+   void keepFirst(unsigned n);
+};
+static_assert(sizeof(StringNode) == pageSize);
+
+// -------------------------------------------------------------------------------------
+// B-tree for variable length keys with the optimistic lock coupling protocol of OLC_BTree.
+// Keys are compared bytewise like std::string_view. Removes leave underfull nodes alone, so
+// nodes are only freed when the tree is destroyed.
+class OLC_StringBTree {
+  private:
+   std::atomic<StringNode*> root;
+   std::atomic<uint64_t> height;
+   NodeArena arena;
+   ContentionCounters contention;
+   BackoffPolicy backoffPolicy;
+   StringNode* newNode(NodeType type) { return new (arena.allocate()) StringNode(type); }
+   void makeRoot(std::string_view sep, StringNode* leftChild, StringNode* rightChild);
+   bool lockParentAndNode(StringNode* parent, uint64_t& versionParent, StringNode* node, uint64_t& versionNode,
+                          bool& needRestart);
+   bool restartAt(TreeOperation op, unsigned level, StringNode* node);
+   // A single optimistic attempt, returns false if the operation has to be retried.
+   // needRestart distinguishes conflicts from retries after a split.
+   bool tryUpsert(std::string_view k, Payload v, bool& needRestart);
+   // Splits the inner node target on the path to k unless it has room for a key of length
+   // keyLength by now. Its parent is split first if it has no room for the separator.
+   bool trySplitInner(StringNode* target, std::string_view k, unsigned keyLength);
+   bool tryFindLeaf(TreeOperation op, std::string_view k, StringNode*& leaf, uint64_t& versionLeaf);
+   StringNode* findLeaf(TreeOperation op, std::string_view k, uint64_t& versionLeaf);
+   bool tryLookup(std::string_view k, Payload& result, bool& found);
+   bool tryRemove(std::string_view k, bool& found);
+
+  public:
+   // Longer keys are rejected, so that every node holds at least three entries.
+   static constexpr unsigned maxKeyLength = 1024;
+
+   explicit OLC_StringBTree(NodeAllocMode allocMode = NodeAllocMode::Default);
+   OLC_StringBTree(const OLC_StringBTree&) = delete;
+   OLC_StringBTree& operator=(const OLC_StringBTree&) = delete;
+   uint64_t getHeight() { return height; }
+   // Insert or update if the key exists, throws std::length_error for keys longer than maxKeyLength.
+   void upsert(std::string_view k, Payload v);
+   bool lookup(std::string_view k, Payload& result);
+   bool remove(std::string_view k); // false if the key did not exist
+   // Appends up to limit keys >= start in key order to keysOut and copies their payloads into
+   // payloadsOut, which may be nullptr. Returns the number of entries copied.
+   uint64_t scan(std::string_view start, uint64_t limit, std::vector<std::string>& keysOut, Payload* payloadsOut);
+   ContentionStats stats() const { return contention.collect(); }
+   void resetStats() { contention.reset(); }
+   // Must not be called concurrently with other operations.
+   void setBackoffPolicy(const BackoffPolicy& policy) { backoffPolicy = policy; }
+};
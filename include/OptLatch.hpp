@@ -1,8 +1,74 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <thread>
+
+// -------------------------------------------------------------------------------------
+// How a thread waits before it retries an operation after a latch conflict. Retrying
+// immediately keeps the contended cache line bouncing between the cores.
+struct BackoffPolicy {
+   enum class Kind : uint8_t {
+      Spin,       // retry immediately
+      Pause,      // a single pause instruction
+      Exponential // the number of pauses doubles with every restart, up to maxPauses
+   };
+   Kind kind = Kind::Exponential;
+   unsigned maxPauses = 1024;
+   unsigned yieldAfter = 16; // yield the CPU from this many consecutive restarts on, 0 never
+};
+
+// Waits according to the policy, one instance per operation.
+class Backoff {
+   BackoffPolicy policy;
+   unsigned restarts = 0;
+
+  public:
+   explicit Backoff(const BackoffPolicy& policy) : policy(policy) {}
+
+   static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__)
+      asm volatile("yield");
+#endif
+   }
+
+   void wait() {
+      ++restarts;
+      if (policy.yieldAfter > 0 && restarts >= policy.yieldAfter) {
+         std::this_thread::yield();
+         return;
+      }
+      switch (policy.kind) {
+         case BackoffPolicy::Kind::Spin:
+            break;
+         case BackoffPolicy::Kind::Pause:
+            pause();
+            break;
+         case BackoffPolicy::Kind::Exponential: {
+            unsigned pauses = std::min(1u << std::min(restarts - 1, 16u), std::max(policy.maxPauses, 1u));
+            for (unsigned i = 0; i < pauses; ++i) pause();
+            break;
+         }
+      }
+   }
+};
+
+// -------------------------------------------------------------------------------------
+// Optimistic latch with an additional pessimistic shared mode. Shared holders do not
+// change the version, so optimistic readers are not disturbed by them, and writers wait
+// for all shared holders to leave after they locked the version.
 struct OptLatch {
+   static constexpr bool pessimistic = false; // reads never hold the latch
+
    std::atomic<uint64_t> latchVersion{0b100};
+   std::atomic<uint32_t> sharedCount{0}; // fits into the padding in front of the node header
+
+   uint64_t currentVersion() const { return latchVersion.load(); }
+   // Nothing to release, readers do not hold optimistic latches.
+   static void releaseReadLatches() {}
 
    bool isLocked(uint64_t version) {
       return ((version & 0b10) == 0b10);
@@ -29,15 +95,56 @@ struct OptLatch {
    void upgradeToWriteLockOrRestart(uint64_t &version, bool &needRestart) {
       if (latchVersion.compare_exchange_strong(version, version + 0b10)) {
          version = version + 0b10;
+         waitForSharedHolders();
       } else {
          needRestart = true;
       }
    }
 
+   // For callers that already hold a latch further down the tree, where waiting for the
+   // shared holders could deadlock. Fails instead of waiting.
+   void upgradeToWriteLockNoWaitOrRestart(uint64_t &version, bool &needRestart) {
+      if (!latchVersion.compare_exchange_strong(version, version + 0b10)) {
+         needRestart = true;
+         return;
+      }
+      version = version + 0b10;
+      if (sharedCount.load() != 0) {
+         writeUnlock();
+         needRestart = true;
+      }
+   }
+
+   // Shared mode, fails if the latch is write locked or obsolete. seq_cst, together with
+   // the lock and the load in waitForSharedHolders either the writer sees us or we see it.
+   bool tryLockShared() {
+      sharedCount.fetch_add(1);
+      uint64_t version = latchVersion.load();
+      if (isLocked(version) || isObsolete(version)) {
+         sharedCount.fetch_sub(1);
+         return false;
+      }
+      return true;
+   }
+
+   void unlockShared() {
+      sharedCount.fetch_sub(1, std::memory_order_release);
+   }
+
+   void waitForSharedHolders() {
+      // Shared holders only wait for nodes further down the tree, so they make progress.
+      while (sharedCount.load() != 0) Backoff::pause();
+   }
+
    void writeUnlock() {
       latchVersion.fetch_add(0b10);
    }
 
+   // Unlocks and marks the node as obsolete, it is no longer reachable and will be reclaimed.
+   void writeUnlockObsolete() {
+      latchVersion.fetch_add(0b11);
+   }
+
    bool isObsolete(uint64_t version) {
       return (version & 1) == 1;
    }
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "OLC_BTree.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+// -------------------------------------------------------------------------------------
+// Prefix compressed node formats for unsigned integer keys. All keys of a node share the
+// bits above the highest bit in which its smallest and its largest possible key differ.
+// These are stored once as prefix, the entries only keep the lowest 2 or 4 bytes of their
+// key (the whole key if the range is too wide). Nodes over clustered keys hold up to 1.6
+// times as many entries with 8 byte payloads or children and up to 4 times as many without
+// payloads, so the tree gets flatter.
+// Leaves take the range from their keys and widen the suffixes when a key does not share
+// the prefix, so a leaf can become full by an insert. Inner nodes take it from their
+// fences, the range of keys the parent routes to them, which contains every separator that
+// can be inserted later.
+// Bulk loads fill the leaves according to the width their keys need. All inner nodes of a
+// level get the same number of children and the first and the last one have open fences,
+// so bulk loaded inner nodes are sized for whole keys, they gain fanout by later splits.
+// -------------------------------------------------------------------------------------
+template <class Key>
+struct PrefixCoding {
+   static_assert(std::is_integral_v<Key> && std::is_unsigned_v<Key>, "prefix compression needs unsigned integer keys");
+   static constexpr Key maxKey = std::numeric_limits<Key>::max();
+
+   // bytes per suffix of a node whose keys are in [lowest, highest]
+   static unsigned suffixBytes(Key lowest, Key highest) {
+      Key diff = lowest ^ highest;
+      if (sizeof(Key) > 2 && diff <= UINT16_MAX) return 2;
+      if (sizeof(Key) > 4 && diff <= UINT32_MAX) return 4;
+      return sizeof(Key);
+   }
+   // Calls fn with a value of the suffix type. Optimistic readers can see any width, the
+   // unknown ones are treated as whole keys. A writer can change the width of a node
+   // between two loads, so readers load it once per call and derive everything from that.
+   template <class Fn>
+   static auto withSuffix(unsigned bytes, Fn&& fn) {
+      if constexpr (sizeof(Key) > 2) {
+         if (bytes == 2) return fn(uint16_t());
+      }
+      if constexpr (sizeof(Key) > 4) {
+         if (bytes == 4) return fn(uint32_t());
+      }
+      return fn(Key());
+   }
+   static Key prefixOf(Key k, unsigned bytes) {
+      return withSuffix(bytes, [&](auto suffix) -> Key {
+         using Suffix = decltype(suffix);
+         if constexpr (sizeof(Suffix) == sizeof(Key)) {
+            return 0;
+         } else {
+            return k & ~static_cast<Key>(std::numeric_limits<Suffix>::max());
+         }
+      });
+   }
+};
+
+// -------------------------------------------------------------------------------------
+// Same interface as BTreeLeaf. The suffixes are followed by the payloads, both move when
+// the width of the suffixes changes.
+template <class Key = ::Key, class Payload = ::Payload, class Latch = OptLatch>
+struct PrefixLeaf : public BTreeLeafBase<Latch> {
+   static_assert(std::is_trivially_copyable_v<Payload>);
+   using NodeBase = ::NodeBase<Latch>;
+   using Coding = PrefixCoding<Key>;
+   using BTreeLeafBase<Latch>::count;
+   using BTreeLeafBase<Latch>::type;
+   using BTreeLeafBase<Latch>::typeMarker;
+   // -------------------------------------------------------------------------------------
+   static constexpr uint64_t payloadSize=std::is_empty_v<Payload> ? 0 : sizeof(Payload);
+   static constexpr uint64_t dataSize=pageSize-sizeof(NodeBase)-sizeof(PrefixLeaf*)-2*sizeof(Key);
+   static constexpr unsigned capacityFor(unsigned suffixBytes) { return (dataSize-alignof(uint64_t))/(suffixBytes+payloadSize); }
+   static constexpr unsigned maxCapacity=capacityFor(2);
+   // entries that fit with whole keys, narrower suffixes make room for more
+   static constexpr uint64_t maxEntries=capacityFor(sizeof(Key));
+   // entries that fit if all keys are in [lowest, highest], bulk loads size the leaves with it
+   static unsigned capacityForRange(Key lowest, Key highest) { return capacityFor(Coding::suffixBytes(lowest, highest)); }
+   static_assert(maxCapacity <= UINT16_MAX);
+   PrefixLeaf* next; // right sibling, used by range scans
+   Key prefix;
+   uint8_t suffixBytes;
+   alignas(uint64_t) uint8_t data[dataSize];
+   // -------------------------------------------------------------------------------------
+   PrefixLeaf() {
+      static_assert(sizeof(PrefixLeaf) <= pageSize);
+      count=0;
+      type=typeMarker;
+      next=nullptr;
+      prefix=0;
+      suffixBytes=sizeof(Key);
+   }
+   // -------------------------------------------------------------------------------------
+   static unsigned capacityOf(unsigned bytes) { return Coding::withSuffix(bytes, [](auto suffix) { return capacityFor(sizeof(suffix)); }); }
+   unsigned capacity() const { return capacityOf(suffixBytes); }
+   // Optimistic readers can see any count, positions below it stay inside the arrays of
+   // the width bytes.
+   unsigned entryCount(unsigned bytes) const { return std::min<unsigned>(count, capacityOf(bytes)); }
+   unsigned entryCount() const { return entryCount(suffixBytes); }
+   bool isFull() { return count>=capacity(); };
+   bool isUnderfull() { return count<maxEntries/4; };
+   bool canInsert(Key k); // false if a new key k needs a split first
+   bool canMerge(PrefixLeaf* right);
+   Key keyAt(unsigned pos) const { return keyAt(pos, suffixBytes); }
+   unsigned lowerBound(Key k) { return lowerBound(k, suffixBytes); }
+   bool find(Key k,Payload& p); // sets p if k exists
+   bool contains(Key k);
+   void insert(Key k,Payload p); // inserts k or updates its payload if k already exists, caller checks canInsert
+   bool remove(Key k); // false if k does not exist
+   PrefixLeaf* split(Key& sep, NodeArena& arena); // moves the upper half into a new leaf, sep is the shortestSeparator between them
+   void merge(PrefixLeaf* right); // appends all entries of the right sibling, caller checks canMerge
+   // Evens out the entries with the right sibling and returns the new separator. If the
+   // halves would not fit, both stay as they are and the separator is recomputed.
+   Key rebalance(PrefixLeaf* right);
+   void load(const Key* keys,const Payload* payloads,unsigned n,const Key* lowerFence,const Key* upperFence);
+   unsigned copyEntries(Key from,bool exclusive,uint64_t limit,Key* keysOut,Payload* payloadsOut);
+   bool isSorted() { return true; }
+   void sortEntries() {}
+
+  private:
+   template <class Suffix>
+   Suffix* suffixes() { return reinterpret_cast<Suffix*>(data); }
+   template <class Suffix>
+   const Suffix* suffixes() const { return reinterpret_cast<const Suffix*>(data); }
+   // The functions taking bytes use that width instead of loading suffixBytes again.
+   // keyAt clamps pos to the capacity of the width.
+   Key keyAt(unsigned pos,unsigned bytes) const;
+   unsigned lowerBound(Key k,unsigned bytes);
+   Payload* payloads(unsigned bytes) {
+      uint64_t offset=Coding::withSuffix(bytes, [](auto suffix) { return capacityFor(sizeof(suffix))*sizeof(suffix); });
+      return reinterpret_cast<Payload*>(data+((offset+alignof(uint64_t)-1)&~(alignof(uint64_t)-1)));
+   }
+   Payload* payloads() { return payloads(suffixBytes); }
+   // Decodes all entries, payloadsOut may be nullptr.
+   void decode(Key* keysOut,Payload* payloadsOut);
+   // Replaces all entries by the n ascending ones, the width follows from the first and last key.
+   void encode(const Key* keys,const Payload* payloadsIn,unsigned n);
+};
+
+// -------------------------------------------------------------------------------------
+// Same interface as BTreeInner, the node covers the keys in [lowest, highest]. The children
+// are followed by the suffixes of the separators.
+template <class Key = ::Key, class Latch = OptLatch>
+struct PrefixInner : public BTreeInnerBase<Latch> {
+   using NodeBase = ::NodeBase<Latch>;
+   using Coding = PrefixCoding<Key>;
+   using BTreeInnerBase<Latch>::count;
+   using BTreeInnerBase<Latch>::type;
+   using BTreeInnerBase<Latch>::typeMarker;
+   static constexpr uint64_t dataSize=pageSize-sizeof(NodeBase)-4*sizeof(Key);
+   static constexpr unsigned capacityFor(unsigned suffixBytes) { return dataSize/(suffixBytes+sizeof(NodeBase*)); }
+   static constexpr unsigned maxCapacity=capacityFor(2);
+   static constexpr uint64_t maxEntries=capacityFor(sizeof(Key));
+   Key lowest; // fences
+   Key highest;
+   Key prefix;
+   uint8_t suffixBytes;
+   alignas(NodeBase*) uint8_t data[dataSize];
+   // -------------------------------------------------------------------------------------
+   PrefixInner() {
+      static_assert(sizeof(PrefixInner) <= pageSize);
+      // rebalance gives both nodes half of the entries of a full and an underfull node,
+      // they have to fit without compression
+      static_assert((maxCapacity+maxEntries/4-1)/2 <= maxEntries-1);
+      count=0;
+      type=typeMarker;
+      lowest=0;
+      highest=Coding::maxKey;
+      prefix=0;
+      suffixBytes=sizeof(Key);
+   }
+   // -------------------------------------------------------------------------------------
+   static unsigned capacityOf(unsigned bytes) { return Coding::withSuffix(bytes, [](auto suffix) { return capacityFor(sizeof(suffix)); }); }
+   unsigned capacity() const { return capacityOf(suffixBytes); }
+   // Optimistic readers can see any count, positions up to it stay inside the arrays of
+   // the width bytes.
+   unsigned entryCount(unsigned bytes) const { return std::min<unsigned>(count, capacityOf(bytes)-1); }
+   unsigned entryCount() const { return entryCount(suffixBytes); }
+   bool isFull() { return count>=capacity()-1; };
+   bool isUnderfull() { return count<maxEntries/4; };
+   bool canMerge(PrefixInner* right) {
+      return static_cast<uint64_t>(count)+right->count+1<capacityFor(Coding::suffixBytes(lowest, right->highest))-1;
+   }
+   unsigned lowerBound(Key k);
+   NodeBase* childAt(unsigned pos) { return children()[pos]; }
+   void setChildAt(unsigned pos,NodeBase* child) { children()[pos]=child; }
+   Key keyAt(unsigned pos) const { return keyAt(pos, suffixBytes); }
+   void setKeyAt(unsigned pos,Key k); // k has to stay between its neighbours
+   PrefixInner* split(Key& sep, NodeArena& arena); // moves the upper half into a new node, sep is pushed up to the parent
+   void insert(Key k,NodeBase* child); // child becomes the right neighbour of the separator k
+   void removeAt(unsigned pos); // removes the separator at pos and its right child
+   void merge(Key sep, PrefixInner* right); // sep is the separator between this node and right in the parent, caller checks canMerge
+   Key rebalance(Key sep, PrefixInner* right); // returns the new separator for the parent
+   void load(NodeBase* const* children,const Key* keys,unsigned n,const Key* lowerFence,const Key* upperFence);
+   void copyFrom(const PrefixInner& other); // copies all entries, the latch and the type stay
+
+  private:
+   NodeBase** children() { return reinterpret_cast<NodeBase**>(data); }
+   template <class Suffix>
+   Suffix* suffixes() { return reinterpret_cast<Suffix*>(data+capacityFor(sizeof(Suffix))*sizeof(NodeBase*)); }
+   template <class Suffix>
+   const Suffix* suffixes() const { return reinterpret_cast<const Suffix*>(data+capacityFor(sizeof(Suffix))*sizeof(NodeBase*)); }
+   Key keyAt(unsigned pos,unsigned bytes) const; // clamps pos to the capacity of the width bytes
+   void decode(Key* keysOut,NodeBase** childrenOut);
+   // Replaces all entries by n separators and n+1 children and sets the fences.
+   void encode(const Key* keys,NodeBase* const* childrenIn,unsigned n,Key low,Key high);
+};
+
+// -------------------------------------------------------------------------------------
+// OLC_BTree<Key, Payload, Latch, PrefixNodes> uses the prefix compressed formats for all nodes.
+struct PrefixNodes {
+   template <class Key, class Payload, class Latch>
+   using Leaf = PrefixLeaf<Key, Payload, Latch>;
+   template <class Key, class Latch>
+   using Inner = PrefixInner<Key, Latch>;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+// -------------------------------------------------------------------------------------
+// Dense ids for the threads using the trees, so per-thread state can live in plain arrays.
+// An id is handed out on first use and reused after the thread exits.
+// -------------------------------------------------------------------------------------
+
+static constexpr unsigned maxThreads = 256;
+
+unsigned threadId();
+// All ids handed out so far are smaller than this.
+unsigned threadIdHighWatermark();
@@ -0,0 +1,31 @@
+#include "ContentionStats.hpp"
+
+ContentionCounters::ContentionCounters() : threads(new ThreadCounters[maxThreads]) {}
+
+ContentionStats ContentionCounters::collect() const {
+    ContentionStats stats;
+    unsigned watermark = threadIdHighWatermark();
+    for (unsigned i = 0; i < watermark; ++i) {
+        for (unsigned op = 0; op < ContentionStats::operations; ++op) {
+            for (unsigned cause = 0; cause < ContentionStats::causes; ++cause) {
+                stats.restarts[op][cause] += threads[i].restarts[op][cause].load(std::memory_order_relaxed);
+            }
+            for (unsigned level = 0; level < ContentionStats::maxLevels; ++level) {
+                stats.restartsByLevel[op][level] += threads[i].restartsByLevel[op][level].load(std::memory_order_relaxed);
+            }
+            stats.sharedFallbacks[op] += threads[i].sharedFallbacks[op].load(std::memory_order_relaxed);
+        }
+    }
+    return stats;
+}
+
+void ContentionCounters::reset() {
+    unsigned watermark = threadIdHighWatermark();
+    for (unsigned i = 0; i < watermark; ++i) {
+        for (unsigned op = 0; op < ContentionStats::operations; ++op) {
+            for (auto& counter : threads[i].restarts[op]) counter.store(0, std::memory_order_relaxed);
+            for (auto& counter : threads[i].restartsByLevel[op]) counter.store(0, std::memory_order_relaxed);
+            threads[i].sharedFallbacks[op].store(0, std::memory_order_relaxed);
+        }
+    }
+}
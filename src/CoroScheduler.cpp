@@ -0,0 +1,23 @@
+#include "CoroScheduler.hpp"
+
+CoroScheduler::~CoroScheduler() {
+    for (auto handle : pending) handle.destroy();
+    for (auto handle : ready) handle.destroy();
+}
+
+void CoroScheduler::run() {
+    while (!pending.empty() || !ready.empty()) {
+        while (ready.size() < maxInFlight && !pending.empty()) {
+            ready.push_back(pending.front());
+            pending.pop_front();
+        }
+        std::coroutine_handle<> handle = ready.front();
+        ready.pop_front();
+        handle.resume();
+        if (handle.done()) {
+            handle.destroy();
+        } else {
+            ready.push_back(handle);
+        }
+    }
+}
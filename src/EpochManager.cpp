@@ -0,0 +1,42 @@
+#include "EpochManager.hpp"
+#include <algorithm>
+
+EpochManager::EpochManager(Reclaimer reclaimer, void* context)
+    : threads(new ThreadState[maxThreads]), reclaimer(reclaimer), context(context) {}
+
+EpochManager::~EpochManager() {
+    for (unsigned i = 0; i < maxThreads; ++i) {
+        for (auto& retired : threads[i].retired) {
+            retired.reclaimer(retired.context, retired.ptr);
+        }
+    }
+}
+
+void EpochManager::retire(void* ptr, Reclaimer reclaimer, void* context) {
+    ThreadState& state = threads[threadId()];
+    state.retired.push_back({ptr, globalEpoch.load(), reclaimer, context});
+    if (state.retired.size() >= reclaimBatch) {
+        globalEpoch.fetch_add(1);
+        reclaim(state);
+    }
+}
+
+uint64_t EpochManager::minActiveEpoch() {
+    uint64_t minEpoch = idle;
+    unsigned watermark = threadIdHighWatermark();
+    for (unsigned i = 0; i < watermark; ++i) {
+        minEpoch = std::min(minEpoch, threads[i].epoch.load());
+    }
+    return minEpoch;
+}
+
+void EpochManager::reclaim(ThreadState& state) {
+    // A thread that entered in epoch e may still hold nodes retired in epoch e or later.
+    uint64_t safeEpoch = minActiveEpoch();
+    auto stillInUse = std::partition(state.retired.begin(), state.retired.end(),
+                                     [&](const Retired& retired) { return retired.epoch >= safeEpoch; });
+    for (auto it = stillInUse; it != state.retired.end(); ++it) {
+        it->reclaimer(it->context, it->ptr);
+    }
+    state.retired.erase(stillInUse, state.retired.end());
+}
@@ -0,0 +1,181 @@
+#include "FingerprintNodes.hpp"
+#include "NodeSearch.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <utility>
+
+// -------------------------------------------------------------------------------------
+// FINGERPRINT LEAF
+// -------------------------------------------------------------------------------------
+template <class Key, class Payload, class Latch>
+unsigned FingerprintLeaf<Key, Payload, Latch>::position(Key k) {
+    unsigned n = entryCount();
+    uint8_t f = fingerprint(k);
+    for (unsigned pos = findByte(fingerprints, 0, n, f); pos < n; pos = findByte(fingerprints, pos + 1, n, f)) {
+        if (keys[pos] == k) return pos;
+    }
+    return n;
+}
+
+template <class Key, class Payload, class Latch>
+bool FingerprintLeaf<Key, Payload, Latch>::find(Key k, Payload& p) {
+    unsigned pos = position(k);
+    if (pos >= entryCount()) return false;
+    p = payloads[pos];
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+bool FingerprintLeaf<Key, Payload, Latch>::contains(Key k) {
+    return position(k) < entryCount();
+}
+
+template <class Key, class Payload, class Latch>
+void FingerprintLeaf<Key, Payload, Latch>::insert(Key k, Payload p) {
+    unsigned pos = position(k);
+    if (pos < count) {
+        payloads[pos] = p;
+        return;
+    }
+    // appending behind the largest key keeps the leaf sorted
+    if (sorted == count && (count == 0 || keys[count - 1] < k)) ++sorted;
+    fingerprints[count] = fingerprint(k);
+    keys[count] = k;
+    payloads[count] = p;
+    ++count;
+}
+
+template <class Key, class Payload, class Latch>
+bool FingerprintLeaf<Key, Payload, Latch>::remove(Key k) {
+    unsigned pos = position(k);
+    if (pos >= count) return false;
+    --count;
+    moveEntries(pos, this, count, 1);
+    sorted = std::min<unsigned>(sorted, pos);
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+void FingerprintLeaf<Key, Payload, Latch>::moveEntries(unsigned to, FingerprintLeaf* from, unsigned pos, unsigned n) {
+    std::memmove(fingerprints + to, from->fingerprints + pos, n);
+    std::memmove(keys + to, from->keys + pos, sizeof(Key) * n);
+    if (from == this) {
+        payloads.move(to, pos, n);
+    } else {
+        payloads.copy(to, from->payloads, pos, n);
+    }
+}
+
+template <class Key, class Payload, class Latch>
+void FingerprintLeaf<Key, Payload, Latch>::sortEntries() {
+    if (sorted >= count) return;
+    // the positions of the sorted entries, followed by the others in key order, are merged
+    auto byKey = [this](uint16_t a, uint16_t b) { return keys[a] < keys[b]; };
+    uint16_t runs[maxEntries];
+    uint16_t order[maxEntries];
+    std::iota(runs, runs + count, 0);
+    std::sort(runs + sorted, runs + count, byKey);
+    std::merge(runs, runs + sorted, runs + sorted, runs + count, order, byKey);
+
+    Key sortedKeys[maxEntries];
+    PayloadArray<Payload, maxEntries> sortedPayloads;
+    for (unsigned i = 0; i < count; ++i) {
+        sortedKeys[i] = keys[order[i]];
+        sortedPayloads[i] = payloads[order[i]];
+    }
+    std::memcpy(keys, sortedKeys, sizeof(Key) * count);
+    payloads.copy(0, sortedPayloads, 0, count);
+    for (unsigned i = 0; i < count; ++i) fingerprints[i] = fingerprint(keys[i]);
+    sorted = count;
+}
+
+template <class Key, class Payload, class Latch>
+FingerprintLeaf<Key, Payload, Latch>* FingerprintLeaf<Key, Payload, Latch>::split(Key& sep, NodeArena& arena) {
+    sortEntries();
+    FingerprintLeaf* newLeaf = new (arena.allocate()) FingerprintLeaf();
+    unsigned moved = count - (count / 2);
+    count = count - moved;
+    newLeaf->moveEntries(0, this, count, moved);
+    newLeaf->count = moved;
+    newLeaf->sorted = moved;
+    sorted = count;
+    sep = shortestSeparator(keys[count - 1], newLeaf->keys[0]);
+    newLeaf->next = next;
+    next = newLeaf;
+    return newLeaf;
+}
+
+template <class Key, class Payload, class Latch>
+void FingerprintLeaf<Key, Payload, Latch>::merge(FingerprintLeaf* right) {
+    moveEntries(count, right, 0, right->count);
+    // all keys of right are larger, its sorted entries continue a sorted leaf
+    if (sorted == count) sorted = count + right->sorted;
+    count += right->count;
+    next = right->next;
+}
+
+template <class Key, class Payload, class Latch>
+Key FingerprintLeaf<Key, Payload, Latch>::rebalance(FingerprintLeaf* right) {
+    sortEntries();
+    right->sortEntries();
+    unsigned total = count + right->count;
+    unsigned leftCount = total / 2;
+    if (count < leftCount) {
+        unsigned moved = leftCount - count;
+        moveEntries(count, right, 0, moved);
+        right->moveEntries(0, right, moved, right->count - moved);
+    } else {
+        unsigned moved = count - leftCount;
+        right->moveEntries(moved, right, 0, right->count);
+        right->moveEntries(0, this, leftCount, moved);
+    }
+    count = leftCount;
+    sorted = leftCount;
+    right->count = total - leftCount;
+    right->sorted = right->count;
+    return shortestSeparator(keys[count - 1], right->keys[0]);
+}
+
+template <class Key, class Payload, class Latch>
+void FingerprintLeaf<Key, Payload, Latch>::load(const Key* in, const Payload* payloadsIn, unsigned n, const Key*, const Key*) {
+    std::memcpy(keys, in, sizeof(Key) * n);
+    if (payloadsIn) payloads.load(0, payloadsIn, n);
+    for (unsigned i = 0; i < n; ++i) fingerprints[i] = fingerprint(keys[i]);
+    count = n;
+    sorted = n;
+}
+
+template <class Key, class Payload, class Latch>
+unsigned FingerprintLeaf<Key, Payload, Latch>::copyEntries(Key from, bool exclusive, uint64_t limit, Key* keysOut, Payload* payloadsOut) {
+    unsigned n = entryCount();
+    if (sorted >= n) {
+        unsigned pos = ::lowerBound(keys, n, from);
+        if (exclusive && pos < n && keys[pos] == from) ++pos;
+        if (pos >= n) return 0;
+        unsigned copied = std::min<uint64_t>(n - pos, limit);
+        std::memcpy(keysOut, keys + pos, sizeof(Key) * copied);
+        if (payloadsOut) payloads.store(pos, payloadsOut, copied);
+        return copied;
+    }
+    // Only scans that lost the race with an insert after sorting the leaf get here. The keys
+    // are copied first, so a writer changing the leaf cannot break the order of the sort.
+    std::pair<Key, uint16_t> entries[maxEntries];
+    unsigned matching = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        Key k = keys[i];
+        if (from < k || (!exclusive && k == from)) entries[matching++] = {k, static_cast<uint16_t>(i)};
+    }
+    unsigned copied = std::min<uint64_t>(matching, limit);
+    std::partial_sort(entries, entries + copied, entries + matching);
+    for (unsigned i = 0; i < copied; ++i) {
+        keysOut[i] = entries[i].first;
+        if (payloadsOut) payloadsOut[i] = payloads[entries[i].second];
+    }
+    return copied;
+}
+
+// -------------------------------------------------------------------------------------
+template struct FingerprintLeaf<uint64_t, uint64_t, OptLatch>;
+template struct FingerprintLeaf<uint64_t, NoPayload, OptLatch>;
+template struct FingerprintLeaf<uint32_t, uint32_t, OptLatch>;
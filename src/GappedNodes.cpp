@@ -0,0 +1,183 @@
+#include "GappedNodes.hpp"
+#include "NodeSearch.hpp"
+#include <algorithm>
+#include <cstring>
+
+// -------------------------------------------------------------------------------------
+// GAPPED LEAF
+// -------------------------------------------------------------------------------------
+template <class Key, class Payload, class Latch>
+unsigned GappedLeaf<Key, Payload, Latch>::nextSlot(unsigned pos, bool used) const {
+    for (unsigned word = pos / 64; word < bitmapWords; ++word) {
+        uint64_t bits = used ? occupied[word] : ~occupied[word];
+        if (word == pos / 64) bits &= ~uint64_t(0) << (pos % 64);
+        // the last word has bits for slots behind maxEntries, they are never occupied
+        if (bits) return std::min<unsigned>(word * 64 + __builtin_ctzll(bits), maxEntries);
+    }
+    return maxEntries;
+}
+
+template <class Key, class Payload, class Latch>
+unsigned GappedLeaf<Key, Payload, Latch>::previousSlot(unsigned pos, bool used) const {
+    for (unsigned word = std::min<unsigned>(pos / 64, bitmapWords - 1) + 1; word-- > 0;) {
+        uint64_t bits = used ? occupied[word] : ~occupied[word];
+        if (word == pos / 64) bits &= (uint64_t(1) << (pos % 64)) - 1;
+        if (bits) return word * 64 + 63 - __builtin_clzll(bits);
+    }
+    return maxEntries;
+}
+
+template <class Key, class Payload, class Latch>
+unsigned GappedLeaf<Key, Payload, Latch>::position(Key k) {
+    unsigned n = usedSlots();
+    unsigned slot = nextSlot(::lowerBound(keys, n, k), true);
+    return (slot < n && keys[slot] == k) ? slot : n;
+}
+
+template <class Key, class Payload, class Latch>
+bool GappedLeaf<Key, Payload, Latch>::find(Key k, Payload& p) {
+    unsigned slot = position(k);
+    if (slot >= usedSlots()) return false;
+    p = payloads[slot];
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+bool GappedLeaf<Key, Payload, Latch>::contains(Key k) {
+    return position(k) < usedSlots();
+}
+
+template <class Key, class Payload, class Latch>
+void GappedLeaf<Key, Payload, Latch>::insert(Key k, Payload p) {
+    unsigned pos = ::lowerBound(keys, end, k);
+    unsigned slot = nextSlot(pos, true);
+    if (slot < end && keys[slot] == k) {
+        payloads[slot] = p;
+        return;
+    }
+    // All slots before pos hold smaller keys, all used ones behind it larger keys. k goes to
+    // pos if it is free, otherwise the entries up to the nearest gap move away from pos.
+    // pos is maxEntries if k is larger than all keys of a leaf whose last slot is in use.
+    if (pos == maxEntries || (pos < end && isOccupied(pos))) {
+        unsigned right = nextSlot(pos, false);
+        unsigned left = previousSlot(pos, false);
+        if (right < maxEntries && (left == maxEntries || right - pos <= pos - left)) {
+            std::memmove(keys + pos + 1, keys + pos, sizeof(Key) * (right - pos));
+            payloads.move(pos + 1, pos, right - pos);
+            setOccupied(right);
+            end = std::max<unsigned>(end, right + 1);
+        } else {
+            --pos;
+            std::memmove(keys + left, keys + left + 1, sizeof(Key) * (pos - left));
+            payloads.move(left, left + 1, pos - left);
+            setOccupied(left);
+        }
+    } else {
+        setOccupied(pos);
+        end = std::max<unsigned>(end, pos + 1);
+    }
+    keys[pos] = k;
+    payloads[pos] = p;
+    ++count;
+}
+
+template <class Key, class Payload, class Latch>
+bool GappedLeaf<Key, Payload, Latch>::remove(Key k) {
+    unsigned slot = position(k);
+    if (slot >= end) return false;
+    // the key stays in the slot, it is still between its neighbours
+    occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    --count;
+    if (slot + 1 == end) {
+        unsigned last = previousSlot(slot, true);
+        end = (last < maxEntries) ? last + 1 : 0;
+    }
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+unsigned GappedLeaf<Key, Payload, Latch>::gather(Key* keysOut, Payload* payloadsOut) {
+    unsigned n = 0;
+    for (unsigned slot = nextSlot(0, true); slot < end; slot = nextSlot(slot + 1, true)) {
+        keysOut[n] = keys[slot];
+        payloadsOut[n] = payloads[slot];
+        ++n;
+    }
+    return n;
+}
+
+template <class Key, class Payload, class Latch>
+void GappedLeaf<Key, Payload, Latch>::spread(const Key* keysIn, const Payload* payloadsIn, unsigned n) {
+    std::fill(occupied, occupied + bitmapWords, 0);
+    unsigned slot = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned target = i * maxEntries / n;
+        // the gaps in front of an entry get its key
+        for (; slot <= target; ++slot) keys[slot] = keysIn[i];
+        if (payloadsIn) payloads[target] = payloadsIn[i];
+        setOccupied(target);
+    }
+    count = n;
+    end = slot;
+}
+
+template <class Key, class Payload, class Latch>
+GappedLeaf<Key, Payload, Latch>* GappedLeaf<Key, Payload, Latch>::split(Key& sep, NodeArena& arena) {
+    Key allKeys[maxEntries];
+    Payload allPayloads[maxEntries];
+    unsigned total = gather(allKeys, allPayloads);
+    unsigned leftCount = total / 2;
+    GappedLeaf* newLeaf = new (arena.allocate()) GappedLeaf();
+    newLeaf->spread(allKeys + leftCount, allPayloads + leftCount, total - leftCount);
+    spread(allKeys, allPayloads, leftCount);
+    sep = shortestSeparator(allKeys[leftCount - 1], allKeys[leftCount]);
+    newLeaf->next = next;
+    next = newLeaf;
+    return newLeaf;
+}
+
+template <class Key, class Payload, class Latch>
+void GappedLeaf<Key, Payload, Latch>::merge(GappedLeaf* right) {
+    Key allKeys[maxEntries];
+    Payload allPayloads[maxEntries];
+    unsigned total = gather(allKeys, allPayloads);
+    total += right->gather(allKeys + total, allPayloads + total);
+    spread(allKeys, allPayloads, total);
+    next = right->next;
+}
+
+template <class Key, class Payload, class Latch>
+Key GappedLeaf<Key, Payload, Latch>::rebalance(GappedLeaf* right) {
+    Key allKeys[2 * maxEntries];
+    Payload allPayloads[2 * maxEntries];
+    unsigned total = gather(allKeys, allPayloads);
+    total += right->gather(allKeys + total, allPayloads + total);
+    unsigned leftCount = total / 2;
+    spread(allKeys, allPayloads, leftCount);
+    right->spread(allKeys + leftCount, allPayloads + leftCount, total - leftCount);
+    return shortestSeparator(allKeys[leftCount - 1], allKeys[leftCount]);
+}
+
+template <class Key, class Payload, class Latch>
+void GappedLeaf<Key, Payload, Latch>::load(const Key* keysIn, const Payload* payloadsIn, unsigned n, const Key*, const Key*) {
+    spread(keysIn, payloadsIn, n);
+}
+
+template <class Key, class Payload, class Latch>
+unsigned GappedLeaf<Key, Payload, Latch>::copyEntries(Key from, bool exclusive, uint64_t limit, Key* keysOut, Payload* payloadsOut) {
+    unsigned n = usedSlots();
+    unsigned slot = nextSlot(::lowerBound(keys, n, from), true);
+    if (exclusive && slot < n && keys[slot] == from) slot = nextSlot(slot + 1, true);
+    unsigned copied = 0;
+    for (; slot < n && copied < limit; slot = nextSlot(slot + 1, true)) {
+        keysOut[copied] = keys[slot];
+        if (payloadsOut) payloadsOut[copied] = payloads[slot];
+        ++copied;
+    }
+    return copied;
+}
+
+// -------------------------------------------------------------------------------------
+template struct GappedLeaf<uint64_t, uint64_t, OptLatch>;
+template struct GappedLeaf<uint64_t, NoPayload, OptLatch>;
+template struct GappedLeaf<uint32_t, uint32_t, OptLatch>;
@@ -0,0 +1,150 @@
+#include "NodeArena.hpp"
+#include <cstdlib>
+#include <new>
+#include <numa.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+std::atomic<char*> NodeArena::chunkDirectory[NodeArena::maxChunks];
+std::mutex NodeArena::directoryMutex;
+std::vector<uint32_t> NodeArena::freeChunkIndexes;
+uint32_t NodeArena::nextChunkIndex = 1;
+
+NodeArena::NodeArena(NodeAllocMode mode, NumaPlacement placement, unsigned bindNode)
+    : mode(mode), placement(placement), bindNode(bindNode), caches(new ThreadCache[maxThreads]) {
+    if (placement != NumaPlacement::Default && numa_available() < 0) {
+        this->placement = NumaPlacement::Default;
+    }
+    pools.resize((this->placement == NumaPlacement::Local) ? numa_max_node() + 1 : 1);
+}
+
+NodeArena::~NodeArena() {
+    {
+        std::lock_guard<std::mutex> guard(directoryMutex);
+        for (Chunk& chunk : chunks) {
+            if (chunk.index == 0) continue; // registering it failed
+            chunkDirectory[chunk.index].store(nullptr, std::memory_order_relaxed);
+            freeChunkIndexes.push_back(chunk.index);
+        }
+    }
+    for (Chunk& chunk : chunks) {
+        if (chunk.size) {
+            munmap(chunk.mapping, chunk.size);
+        } else {
+            std::free(chunk.mapping);
+        }
+    }
+}
+
+unsigned NodeArena::numaNodes() {
+    return (numa_available() < 0) ? 1 : numa_max_node() + 1;
+}
+
+unsigned NodeArena::currentNumaNode() {
+    if (numa_available() < 0) return 0;
+    int cpu = sched_getcpu();
+    int node = (cpu >= 0) ? numa_node_of_cpu(cpu) : 0;
+    return (node >= 0) ? node : 0;
+}
+
+NodeArena::Pool& NodeArena::currentPool(unsigned& numaNode) {
+    if (placement == NumaPlacement::Bind) {
+        numaNode = bindNode;
+        return pools[0];
+    }
+    numaNode = 0;
+    if (placement == NumaPlacement::Local) {
+        unsigned node = currentNumaNode();
+        numaNode = (node < pools.size()) ? node : 0;
+    }
+    return pools[numaNode];
+}
+
+void NodeArena::registerChunk(char* chunk, Chunk& entry) {
+    std::lock_guard<std::mutex> guard(directoryMutex);
+    if (!freeChunkIndexes.empty()) {
+        entry.index = freeChunkIndexes.back();
+        freeChunkIndexes.pop_back();
+    } else if (nextChunkIndex < maxChunks) {
+        entry.index = nextChunkIndex++;
+    } else {
+        throw std::bad_alloc();
+    }
+    reinterpret_cast<ChunkHeader*>(chunk)->index = entry.index;
+    chunkDirectory[entry.index].store(chunk, std::memory_order_relaxed);
+}
+
+char* NodeArena::allocateChunk(unsigned numaNode) {
+    if (mode == NodeAllocMode::Default && placement == NumaPlacement::Default) {
+        void* chunk = std::aligned_alloc(chunkSize, chunkSize);
+        if (!chunk) throw std::bad_alloc();
+        chunks.push_back({chunk, 0, 0});
+        registerChunk(static_cast<char*>(chunk), chunks.back());
+        return static_cast<char*>(chunk) + nodeSize;
+    }
+
+    // explicit huge pages, only available if the administrator reserved some
+    // mapped memory is not touched yet, so the NUMA policy applies to all of its pages
+    char* chunk = nullptr;
+    if (mode == NodeAllocMode::HugePages) {
+        void* mapping = mmap(nullptr, chunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping != MAP_FAILED) {
+            chunks.push_back({mapping, chunkSize, 0});
+            chunk = static_cast<char*>(mapping);
+        }
+    }
+    if (!chunk) {
+        // Chunks and transparent huge pages need a 2MB aligned range, so we map twice the
+        // size and use the aligned chunk inside of it.
+        size_t mappingSize = 2 * chunkSize;
+        void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) throw std::bad_alloc();
+        chunks.push_back({mapping, mappingSize, 0});
+        chunk = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(mapping) + chunkSize - 1) & ~(chunkSize - 1));
+        if (mode == NodeAllocMode::HugePages) madvise(chunk, chunkSize, MADV_HUGEPAGE);
+    }
+
+    if (placement == NumaPlacement::Interleave) {
+        numa_interleave_memory(chunk, chunkSize, numa_all_nodes_ptr);
+    } else if (placement == NumaPlacement::Local || placement == NumaPlacement::Bind) {
+        numa_tonode_memory(chunk, chunkSize, numaNode);
+    }
+    registerChunk(chunk, chunks.back());
+    return chunk + nodeSize;
+}
+
+void NodeArena::refill(ThreadCache& cache) {
+    std::lock_guard<std::mutex> guard(mutex);
+    unsigned numaNode;
+    Pool& pool = currentPool(numaNode);
+    for (size_t i = 0; i < batchSize; ++i) {
+        FreeNode* node;
+        if (!pool.freeNodes.empty()) {
+            node = pool.freeNodes.back();
+            pool.freeNodes.pop_back();
+        } else {
+            if (pool.chunkPos == pool.chunkEnd) {
+                pool.chunkPos = allocateChunk(numaNode);
+                pool.chunkEnd = pool.chunkPos + chunkSize - nodeSize;
+            }
+            node = reinterpret_cast<FreeNode*>(pool.chunkPos);
+            pool.chunkPos += nodeSize;
+        }
+        node->next = cache.head;
+        cache.head = node;
+        ++cache.count;
+    }
+}
+
+void NodeArena::flush(ThreadCache& cache) {
+    std::lock_guard<std::mutex> guard(mutex);
+    // nodes are not tracked by NUMA node, they go to the pool of the freeing thread
+    unsigned numaNode;
+    Pool& pool = currentPool(numaNode);
+    for (size_t i = 0; i < batchSize; ++i) {
+        FreeNode* node = cache.head;
+        cache.head = node->next;
+        --cache.count;
+        pool.freeNodes.push_back(node);
+    }
+}
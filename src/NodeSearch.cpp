@@ -0,0 +1,148 @@
+#include "NodeSearch.hpp"
+#include <immintrin.h>
+
+// -------------------------------------------------------------------------------------
+// The vector kernels binary search until the remaining window is small and then count
+// the keys smaller than k in the window with a few compares. The window is a multiple of
+// the vector width, so only the tail of the array is handled by scalar code.
+// -------------------------------------------------------------------------------------
+namespace {
+
+template <class T>
+inline void narrowWindow(const T* keys, unsigned& l, unsigned& r, T k, unsigned window) {
+    while (r - l > window) {
+        unsigned mid = l + (r - l) / 2;
+        if (keys[mid] < k) {
+            l = mid + 1;
+        } else {
+            r = mid;
+        }
+    }
+}
+
+template <class T>
+inline unsigned scalarTail(const T* keys, unsigned l, unsigned r, T k) {
+    while (l < r && keys[l] < k) ++l;
+    return l;
+}
+
+}  // namespace
+
+unsigned lowerBoundScalar(const uint64_t* keys, unsigned count, uint64_t k) {
+    unsigned l = 0;
+    unsigned r = count;
+    narrowWindow(keys, l, r, k, 0);
+    return l;
+}
+
+__attribute__((target("sse4.2")))
+unsigned lowerBoundSSE(const uint64_t* keys, unsigned count, uint64_t k) {
+    unsigned l = 0;
+    unsigned r = count;
+    narrowWindow(keys, l, r, k, 8);
+    // there is only a signed 64 bit compare, flipping the sign bit keeps the unsigned order
+    const __m128i flip = _mm_set1_epi64x(INT64_MIN);
+    const __m128i needle = _mm_xor_si128(_mm_set1_epi64x(k), flip);
+    for (; l + 2 <= r; l += 2) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + l)), flip);
+        unsigned smaller = __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(needle, v))));
+        if (smaller < 2) return l + smaller;
+    }
+    return scalarTail(keys, l, r, k);
+}
+
+__attribute__((target("avx2")))
+unsigned lowerBoundAVX2(const uint64_t* keys, unsigned count, uint64_t k) {
+    unsigned l = 0;
+    unsigned r = count;
+    narrowWindow(keys, l, r, k, 16);
+    const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i needle = _mm256_xor_si256(_mm256_set1_epi64x(k), flip);
+    for (; l + 4 <= r; l += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + l)), flip);
+        unsigned smaller = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, v))));
+        if (smaller < 4) return l + smaller;
+    }
+    return scalarTail(keys, l, r, k);
+}
+
+__attribute__((target("avx512f")))
+unsigned lowerBoundAVX512(const uint64_t* keys, unsigned count, uint64_t k) {
+    unsigned l = 0;
+    unsigned r = count;
+    narrowWindow(keys, l, r, k, 32);
+    const __m512i needle = _mm512_set1_epi64(k);
+    for (; l < r; l += 8) {
+        // masked load, so the tail does not read past the end of the array
+        __mmask8 valid = (r - l >= 8) ? 0xFF : static_cast<__mmask8>((1u << (r - l)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi64(valid, keys + l);
+        unsigned smaller = __builtin_popcount(_mm512_mask_cmplt_epu64_mask(valid, v, needle));
+        if (smaller < 8) return l + smaller;
+    }
+    return r;
+}
+
+unsigned lowerBound(const uint32_t* keys, unsigned count, uint32_t k) {
+    unsigned l = 0;
+    unsigned r = count;
+    narrowWindow(keys, l, r, k, 16);
+    const __m128i flip = _mm_set1_epi32(INT32_MIN);
+    const __m128i needle = _mm_xor_si128(_mm_set1_epi32(k), flip);
+    for (; l + 4 <= r; l += 4) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + l)), flip);
+        unsigned smaller = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, v))));
+        if (smaller < 4) return l + smaller;
+    }
+    return scalarTail(keys, l, r, k);
+}
+
+unsigned lowerBound(const uint16_t* keys, unsigned count, uint16_t k) {
+    unsigned l = 0;
+    unsigned r = count;
+    narrowWindow(keys, l, r, k, 32);
+    const __m128i flip = _mm_set1_epi16(INT16_MIN);
+    const __m128i needle = _mm_xor_si128(_mm_set1_epi16(k), flip);
+    for (; l + 8 <= r; l += 8) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + l)), flip);
+        // the byte mask has two bits per 16 bit lane
+        unsigned smaller = __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi16(needle, v))) / 2;
+        if (smaller < 8) return l + smaller;
+    }
+    return scalarTail(keys, l, r, k);
+}
+
+unsigned findByte(const uint8_t* bytes, unsigned from, unsigned count, uint8_t byte) {
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(byte));
+    for (unsigned block = from & ~15u; block < count; block += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + block));
+        unsigned matches = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (block < from) matches &= ~0u << (from - block);
+        if (matches) {
+            unsigned pos = block + __builtin_ctz(matches);
+            return (pos < count) ? pos : count;
+        }
+    }
+    return count;
+}
+
+// -------------------------------------------------------------------------------------
+namespace {
+
+LowerBoundFn selectLowerBound() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return lowerBoundAVX512;
+    if (__builtin_cpu_supports("avx2")) return lowerBoundAVX2;
+    if (__builtin_cpu_supports("sse4.2")) return lowerBoundSSE;
+    return lowerBoundScalar;
+}
+
+}  // namespace
+
+const LowerBoundFn lowerBoundKernel = selectLowerBound();
+
+const char* lowerBoundKernelName() {
+    if (lowerBoundKernel == lowerBoundAVX512) return "avx512";
+    if (lowerBoundKernel == lowerBoundAVX2) return "avx2";
+    if (lowerBoundKernel == lowerBoundSSE) return "sse4.2";
+    return "scalar";
+}
@@ -1,288 +1,1188 @@
 #include "OLC_BTree.hpp"
-#include <iostream>
+#include "FingerprintNodes.hpp"
+#include "GappedNodes.hpp"
+#include "NodeSearch.hpp"
+#include "PrefixNodes.hpp"
+#include <algorithm>
+#include <cstring>
 
 // -------------------------------------------------------------------------------------
 // BTREE NODES
 // -------------------------------------------------------------------------------------
-unsigned BTreeLeaf::lowerBound(Key k) {
-    unsigned l=0;
-    unsigned r=count;
-    while (l < r) {
-        unsigned mid = l+(r-l)/2;
-        if (keys[mid] < k) {
-            l = mid + 1;
-        } else {
-            r = mid;
+template <class Key, class Payload, class Latch>
+unsigned BTreeLeaf<Key, Payload, Latch>::lowerBound(Key k) {
+    return ::lowerBound(keys, count, k);
+}
+
+template <class Key, class Payload, class Latch>
+bool BTreeLeaf<Key, Payload, Latch>::find(Key k, Payload& p) {
+    unsigned pos = lowerBound(k);
+    if (pos >= count || keys[pos] != k) return false;
+    p = payloads[pos];
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+bool BTreeLeaf<Key, Payload, Latch>::contains(Key k) {
+    unsigned pos = lowerBound(k);
+    return pos < count && keys[pos] == k;
+}
+
+template <class Key, class Payload, class Latch>
+void BTreeLeaf<Key, Payload, Latch>::insert(Key k, Payload p) {
+    unsigned pos = lowerBound(k);
+    if (pos < count && keys[pos] == k) {
+        payloads[pos] = p;
+        return;
+    }
+    std::memmove(keys + pos + 1, keys + pos, sizeof(Key) * (count - pos));
+    payloads.move(pos + 1, pos, count - pos);
+    keys[pos] = k;
+    payloads[pos] = p;
+    ++count;
+}
+
+template <class Key, class Payload, class Latch>
+bool BTreeLeaf<Key, Payload, Latch>::remove(Key k) {
+    unsigned pos = lowerBound(k);
+    if (pos >= count || keys[pos] != k) return false;
+    std::memmove(keys + pos, keys + pos + 1, sizeof(Key) * (count - pos - 1));
+    payloads.move(pos, pos + 1, count - pos - 1);
+    --count;
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+BTreeLeaf<Key, Payload, Latch>* BTreeLeaf<Key, Payload, Latch>::split(Key& sep, NodeArena& arena) {
+    BTreeLeaf* newLeaf = new (arena.allocate()) BTreeLeaf();
+    newLeaf->count = count - (count / 2);
+    count = count - newLeaf->count;
+    std::memcpy(newLeaf->keys, keys + count, sizeof(Key) * newLeaf->count);
+    newLeaf->payloads.copy(0, payloads, count, newLeaf->count);
+    sep = shortestSeparator(keys[count - 1], newLeaf->keys[0]);
+    newLeaf->next = next;
+    next = newLeaf;
+    return newLeaf;
+}
+
+template <class Key, class Payload, class Latch>
+void BTreeLeaf<Key, Payload, Latch>::merge(BTreeLeaf* right) {
+    std::memcpy(keys + count, right->keys, sizeof(Key) * right->count);
+    payloads.copy(count, right->payloads, 0, right->count);
+    count += right->count;
+    next = right->next;
+}
+
+template <class Key, class Payload, class Latch>
+Key BTreeLeaf<Key, Payload, Latch>::rebalance(BTreeLeaf* right) {
+    unsigned total = count + right->count;
+    unsigned leftCount = total / 2;
+    if (count < leftCount) {
+        unsigned moved = leftCount - count;
+        std::memcpy(keys + count, right->keys, sizeof(Key) * moved);
+        payloads.copy(count, right->payloads, 0, moved);
+        std::memmove(right->keys, right->keys + moved, sizeof(Key) * (right->count - moved));
+        right->payloads.move(0, moved, right->count - moved);
+    } else {
+        unsigned moved = count - leftCount;
+        std::memmove(right->keys + moved, right->keys, sizeof(Key) * right->count);
+        right->payloads.move(moved, 0, right->count);
+        std::memcpy(right->keys, keys + leftCount, sizeof(Key) * moved);
+        right->payloads.copy(0, payloads, leftCount, moved);
+    }
+    count = leftCount;
+    right->count = total - leftCount;
+    return shortestSeparator(keys[count - 1], right->keys[0]);
+}
+
+template <class Key, class Payload, class Latch>
+void BTreeLeaf<Key, Payload, Latch>::load(const Key* in, const Payload* payloadsIn, unsigned n, const Key*, const Key*) {
+    std::memcpy(keys, in, sizeof(Key) * n);
+    if (payloadsIn) payloads.load(0, payloadsIn, n);
+    count = n;
+}
+
+template <class Key, class Payload, class Latch>
+unsigned BTreeLeaf<Key, Payload, Latch>::copyEntries(Key from, bool exclusive, uint64_t limit, Key* keysOut, Payload* payloadsOut) {
+    // Scans copy under an optimistic read, a concurrent remove can shrink count between two
+    // loads. It is read once and clamped, so the copy stays inside the leaf until validation.
+    unsigned n = std::min<unsigned>(count, maxEntries);
+    unsigned pos = ::lowerBound(keys, n, from);
+    if (exclusive && pos < n && keys[pos] == from) ++pos;
+    if (pos >= n) return 0;
+    unsigned copied = std::min<uint64_t>(n - pos, limit);
+    std::memcpy(keysOut, keys + pos, sizeof(Key) * copied);
+    if (payloadsOut) payloads.store(pos, payloadsOut, copied);
+    return copied;
+}
+
+// -------------------------------------------------------------------------------------
+template <class Key, class Latch, class Child>
+unsigned BTreeInner<Key, Latch, Child>::lowerBound(Key k) {
+    return ::lowerBound(keys, count, k);
+}
+
+template <class Key, class Latch, class Child>
+BTreeInner<Key, Latch, Child>* BTreeInner<Key, Latch, Child>::split(Key& sep, NodeArena& arena) {
+    BTreeInner* newInner = new (arena.allocate()) BTreeInner();
+    newInner->count = count - (count / 2);
+    count = count - newInner->count - 1;
+    sep = keys[count];
+    std::memcpy(newInner->keys, keys + count + 1, sizeof(Key) * (newInner->count + 1));
+    std::memcpy(newInner->children, children + count + 1, sizeof(Child) * (newInner->count + 1));
+    return newInner;
+}
+
+template <class Key, class Latch, class Child>
+void BTreeInner<Key, Latch, Child>::insert(Key k, NodeBase* child) {
+    unsigned pos = lowerBound(k);
+    std::memmove(keys + pos + 1, keys + pos, sizeof(Key) * (count - pos + 1));
+    std::memmove(children + pos + 1, children + pos, sizeof(Child) * (count - pos + 1));
+    keys[pos] = k;
+    children[pos] = child;
+    // the split node keeps the lower half, so it has to stay left of the separator
+    std::swap(children[pos], children[pos + 1]);
+    ++count;
+}
+
+template <class Key, class Latch, class Child>
+void BTreeInner<Key, Latch, Child>::removeAt(unsigned pos) {
+    std::memmove(keys + pos, keys + pos + 1, sizeof(Key) * (count - pos - 1));
+    std::memmove(children + pos + 1, children + pos + 2, sizeof(Child) * (count - pos - 1));
+    --count;
+}
+
+template <class Key, class Latch, class Child>
+void BTreeInner<Key, Latch, Child>::merge(Key sep, BTreeInner* right) {
+    keys[count] = sep;
+    std::memcpy(keys + count + 1, right->keys, sizeof(Key) * right->count);
+    std::memcpy(children + count + 1, right->children, sizeof(Child) * (right->count + 1));
+    count += right->count + 1;
+}
+
+template <class Key, class Latch, class Child>
+Key BTreeInner<Key, Latch, Child>::rebalance(Key sep, BTreeInner* right) {
+    // Concatenate both nodes with the parent separator in between and cut in the middle.
+    Key allKeys[2 * maxEntries];
+    Child allChildren[2 * maxEntries];
+    unsigned total = count + right->count + 1;
+    std::memcpy(allKeys, keys, sizeof(Key) * count);
+    allKeys[count] = sep;
+    std::memcpy(allKeys + count + 1, right->keys, sizeof(Key) * right->count);
+    std::memcpy(allChildren, children, sizeof(Child) * (count + 1));
+    std::memcpy(allChildren + count + 1, right->children, sizeof(Child) * (right->count + 1));
+
+    count = total / 2;
+    right->count = total - count - 1;
+    std::memcpy(keys, allKeys, sizeof(Key) * count);
+    std::memcpy(children, allChildren, sizeof(Child) * (count + 1));
+    std::memcpy(right->keys, allKeys + count + 1, sizeof(Key) * right->count);
+    std::memcpy(right->children, allChildren + count + 1, sizeof(Child) * (right->count + 1));
+    return allKeys[count];
+}
+
+template <class Key, class Latch, class Child>
+void BTreeInner<Key, Latch, Child>::load(NodeBase* const* in, const Key* keysIn, unsigned n, const Key*, const Key*) {
+    std::copy(in, in + n, children);
+    std::memcpy(keys, keysIn, sizeof(Key) * (n - 1));
+    count = n - 1;
+}
+
+template <class Key, class Latch, class Child>
+void BTreeInner<Key, Latch, Child>::copyFrom(const BTreeInner& other) {
+    count = other.count;
+    std::memcpy(keys, other.keys, sizeof(Key) * count);
+    std::memcpy(children, other.children, sizeof(Child) * (count + 1));
+}
+
+// -------------------------------------------------------------------------------------
+
+// -------------------------------------------------------------------------------------
+// BTREE
+// -------------------------------------------------------------------------------------
+template <class Key, class Payload, class Latch, class Nodes>
+OLC_BTree<Key, Payload, Latch, Nodes>::OLC_BTree(NodeAllocMode allocMode, NumaPolicy numaPolicy, unsigned replicatedLevels)
+                         : innerArena(allocMode, innerPlacement(numaPolicy)), leafArena(allocMode, leafPlacement(numaPolicy)),
+                           replicatedLevels(replicatedLevels), epochManager(reclaimNode, this) {
+    root = newNode<BTreeLeaf>();
+    height = 1;
+    if (replicatedLevels > 0) {
+        numReplicas = NodeArena::numaNodes();
+        replicaRoots.reset(new std::atomic<NodeBase*>[numReplicas]);
+        for (unsigned node = 0; node < numReplicas; ++node) {
+            replicaRoots[node] = nullptr;
+            replicaArenas.push_back(std::make_unique<NodeArena>(allocMode, NumaPlacement::Bind, node));
         }
     }
-    return l;
 }
 
-void BTreeLeaf::insert(Key k, Payload p) {
-    bool restart = false;
-    while (true) {
-        writeLockOrRestart(restart);
-        if (!restart) {
-            insertInLeaf(k, p);
-            writeUnlock();
-            return;
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::reclaimNode(void* tree, void* node) {
+    auto self = static_cast<OLC_BTree*>(tree);
+    NodeArena& arena = (static_cast<NodeBase*>(node)->type == NodeType::BTreeLeaf) ? self->leafArena : self->innerArena;
+    arena.free(node);
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::makeRoot(Key k, NodeBase* leftChild, NodeBase* rightChild) {
+    // The caller holds the write latch of the old root, so nobody else can replace it.
+    auto newRoot = newNode<BTreeInner>();
+    newRoot->setChildAt(0, leftChild);
+    newRoot->insert(k, rightChild);
+    root = newRoot;
+    ++height;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::lockParentAndNode(BTreeInner* parent, uint64_t& versionParent, NodeBase* node, uint64_t& versionNode, bool& needRestart) {
+    if (parent) {
+        parent->upgradeToWriteLockOrRestart(versionParent, needRestart);
+        if (needRestart) return false;
+    }
+    node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+    if (needRestart) {
+        if (parent) parent->writeUnlock();
+        return false;
+    }
+    if (!parent && (node != root)) {
+        // the root was replaced after we started the descent
+        node->writeUnlock();
+        needRestart = true;
+        return false;
+    }
+    return true;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::lockStructureChange(BTreeInner* parent, uint64_t& versionParent, NodeBase* node, uint64_t& versionNode,
+                                                         unsigned depth, uint64_t versionReplica, bool& topLevel, bool& needRestart) {
+    topLevel = false;
+    if (!replicaRoots) return lockParentAndNode(parent, versionParent, node, versionNode, needRestart);
+    if (versionReplica & 1) {
+        // the path was read while the replicated levels changed, depth may be off
+        needRestart = true;
+        return false;
+    }
+
+    // The parent is at depth - 1, the root (depth 0) is always part of the replicated levels.
+    topLevel = (depth <= replicatedDepth);
+    if (topLevel) {
+        // Serialize with other changes of the replicated levels before latching, the rebuild
+        // waits for latched nodes and must not wait for a thread waiting for the mutex.
+        replicaMutex.lock();
+        if (replicaVersion != versionReplica) {
+            replicaMutex.unlock();
+            needRestart = true;
+            return false;
         }
+        if (!lockParentAndNode(parent, versionParent, node, versionNode, needRestart)) {
+            replicaMutex.unlock();
+            return false;
+        }
+        // readers stop using the replicas before anything is modified
+        ++replicaVersion;
+        return true;
+    }
+
+    if (!lockParentAndNode(parent, versionParent, node, versionNode, needRestart)) return false;
+    if (replicaVersion != versionReplica) {
+        // the root changed during the descent, so depth is not reliable
+        node->writeUnlock();
+        if (parent) parent->writeUnlock();
+        needRestart = true;
+        return false;
     }
+    return true;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::finishStructureChange(bool topLevel) {
+    if (!topLevel) return;
+    rebuildReplicas();
+    ++replicaVersion;
+    replicaMutex.unlock();
 }
 
-void BTreeLeaf::insertInLeaf(Key k, Payload p) {
-    bool restart = false;
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::rebuildReplicas() {
+    // The leaves' parents change with every leaf split, so they are never replicated.
+    uint64_t levels = (height > 2) ? std::min<uint64_t>(replicatedLevels, height - 2) : 0;
+    for (unsigned n = 0; n < numReplicas; ++n) {
+        NodeBase* old = replicaRoots[n];
+        replicaRoots[n] = (levels > 0) ? copyReplica(static_cast<BTreeInner*>(root.load()), levels, *replicaArenas[n]) : nullptr;
+        if (old) retireReplica(old, *replicaArenas[n]);
+    }
+    replicatedDepth = levels;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+typename OLC_BTree<Key, Payload, Latch, Nodes>::NodeBase* OLC_BTree<Key, Payload, Latch, Nodes>::copyReplica(BTreeInner* master, uint64_t levels, NodeArena& arena) {
+    auto copy = new (arena.allocate()) BTreeInnerReplica();
+    // Writers below the replicated levels may still hold the latch of a node that just
+    // became part of them after a root change, the copy waits until they are done.
+    Backoff backoff(backoffPolicy);
     while (true) {
-        writeLockOrRestart(restart);
-        if (!restart) {
-            insertAndSplitIfNeeded(k, p);
-            writeUnlock();
-            return;
+        bool needRestart = false;
+        uint64_t version = master->readLockOrRestart(needRestart);
+        if (needRestart) {
+            backoff.wait();
+            continue;
         }
+        copy->copyFrom(*master);
+        master->readUnlockOrRestart(version, needRestart);
+        if (!needRestart) break;
+        backoff.wait();
     }
+    if (levels > 1) {
+        for (unsigned i = 0; i <= copy->count; ++i) {
+            copy->setChildAt(i, copyReplica(static_cast<BTreeInner*>(copy->childAt(i)), levels - 1, arena));
+        }
+    }
+    return copy;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::retireReplica(NodeBase* node, NodeArena& arena) {
+    auto replica = static_cast<BTreeInnerReplica*>(node);
+    for (unsigned i = 0; i <= replica->count; ++i) {
+        if (replica->childAt(i)->type == NodeType::BTreeInnerReplica) retireReplica(replica->childAt(i), arena);
+    }
+    epochManager.retire(replica, reclaimReplicaNode, &arena);
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::reclaimReplicaNode(void* arena, void* node) {
+    static_cast<NodeArena*>(arena)->free(node);
 }
 
-void BTreeLeaf::insertAndSplitIfNeeded(Key k, Payload p) {
-    if (isFull()) {
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::descendReplica(Key k, NodeBase*& node, uint64_t& versionNode, unsigned& depth, bool& needRestart) {
+    if (!replicaRoots) return false;
+    uint64_t versionReplica = replicaVersion;
+    if (versionReplica & 1) return false;
+    // threads rarely migrate, a replica on another node is only slower
+    static thread_local unsigned numaNode = NodeArena::currentNumaNode();
+    node = replicaRoots[numaNode % numReplicas];
+    if (!node) return false;
+
+    while (node->type == NodeType::BTreeInnerReplica) {
+        auto replica = static_cast<BTreeInnerReplica*>(node);
+        node = replica->childAt(replica->lowerBound(k));
+        ++depth;
+    }
+    // Every change that could move k out of this node bumps replicaVersion before it
+    // modifies anything, so the node is the right one if the version did not change.
+    versionNode = node->readLockOrRestart(needRestart);
+    if (!needRestart && replicaVersion != versionReplica) needRestart = true;
+    return true;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::tryUpsert(Key k, Payload v, bool& needRestart) {
+    needRestart = false;
+    uint64_t versionReplica = replicaVersion;
+    NodeBase* node = root;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root)) return restartAt(TreeOperation::Upsert, 0, node);
+
+    BTreeInner* parent = nullptr;
+    uint64_t versionParent = 0;
+    unsigned depth = 0;
+    bool topLevel = false;
+
+    while (node->type == NodeType::BTreeInner) {
+        auto inner = static_cast<BTreeInner*>(node);
+
+        // Split eagerly on the way down, so the parent always has room for a separator.
+        if (inner->isFull()) {
+            if (!lockStructureChange(parent, versionParent, node, versionNode, depth, versionReplica, topLevel, needRestart)) {
+                return restartAt(TreeOperation::Upsert, depth, node);
+            }
+            Key sep;
+            BTreeInner* newInner = inner->split(sep, innerArena);
+            if (parent) {
+                parent->insert(sep, newInner);
+            } else {
+                makeRoot(sep, inner, newInner);
+            }
+            node->writeUnlock();
+            if (parent) parent->writeUnlock();
+            finishStructureChange(topLevel);
+            // descend again from the root, this is not a conflict
+            return false;
+        }
+
+        if (parent) {
+            parent->readUnlockOrRestart(versionParent, needRestart);
+            if (needRestart) return restartAt(TreeOperation::Upsert, depth - 1, parent);
+        }
+
+        parent = inner;
+        versionParent = versionNode;
+        ++depth;
+
+        node = inner->childAt(inner->lowerBound(k));
+        inner->checkOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(TreeOperation::Upsert, depth - 1, inner);
+        versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart) return restartAt(TreeOperation::Upsert, depth, node);
+    }
+
+    auto leaf = static_cast<BTreeLeaf*>(node);
+    if (!leaf->canInsert(k) && !leaf->contains(k)) {
+        if (!lockStructureChange(parent, versionParent, node, versionNode, depth, versionReplica, topLevel, needRestart)) {
+            return restartAt(TreeOperation::Upsert, depth, node);
+        }
         Key sep;
-        BTreeLeaf* newleaf = split(sep);
-        if (k >= sep) {
-            newleaf->insertInLeaf(k, p);
+        BTreeLeaf* newLeaf = leaf->split(sep, leafArena);
+        if (parent) {
+            parent->insert(sep, newLeaf);
         } else {
-            insert(k, p);
+            makeRoot(sep, leaf, newLeaf);
+        }
+        node->writeUnlock();
+        if (parent) parent->writeUnlock();
+        finishStructureChange(topLevel);
+        return false;
+    }
+
+    leaf->upgradeToWriteLockOrRestart(versionNode, needRestart);
+    if (needRestart) return restartAt(TreeOperation::Upsert, depth, leaf);
+    if (parent) {
+        parent->readUnlockOrRestart(versionParent, needRestart);
+        if (needRestart) {
+            leaf->writeUnlock();
+            return restartAt(TreeOperation::Upsert, depth - 1, parent);
         }
+    }
+    leaf->insert(k, v);
+    leaf->writeUnlock();
+    return true;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::upsert(Key k, Payload v) {
+    EpochGuard guard(epochManager);
+    bool needRestart = false;
+    Backoff backoff(backoffPolicy);
+    while (!tryUpsert(k, v, needRestart)) {
+        Latch::releaseReadLatches();
+        if (needRestart) backoff.wait();
+    }
+    Latch::releaseReadLatches();
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::restartAt(TreeOperation op, unsigned level, NodeBase* node) {
+    uint64_t version = node->currentVersion();
+    RestartCause cause = RestartCause::VersionChanged;
+    if (node->isObsolete(version)) {
+        cause = RestartCause::Obsolete;
+    } else if (node->isLocked(version)) {
+        cause = RestartCause::Locked;
+    }
+    contention.count(op, level, cause);
+    return false;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::tryFindLeaf(TreeOperation op, Key k, BTreeLeaf*& leaf, uint64_t& versionLeaf) {
+    bool needRestart = false;
+    NodeBase* node = nullptr;
+    uint64_t versionNode = 0;
+    unsigned depth = 0;
+    if (descendReplica(k, node, versionNode, depth, needRestart)) {
+        if (needRestart) return restartAt(op, depth, node);
     } else {
-        insert(k, p);
+        node = root;
+        versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart || (node != root)) return restartAt(op, 0, node);
+    }
+
+    while (node->type == NodeType::BTreeInner) {
+        auto inner = static_cast<BTreeInner*>(node);
+        node = inner->childAt(inner->lowerBound(k));
+        inner->checkOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(op, depth, inner);
+        uint64_t versionChild = node->readLockOrRestart(needRestart);
+        if (needRestart) return restartAt(op, depth + 1, node);
+        inner->readUnlockOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(op, depth, inner);
+        versionNode = versionChild;
+        ++depth;
     }
+
+    leaf = static_cast<BTreeLeaf*>(node);
+    versionLeaf = versionNode;
+    return true;
 }
 
-BTreeLeaf* BTreeLeaf::split(Key& sep) {
-    bool restart = false;
-    while (true) {
-        writeLockOrRestart(restart);
-        if (!restart) {
-            BTreeLeaf* newleaf = new BTreeLeaf();
-            unsigned mid = count / 2;
-            sep = keys[mid];
-            for (unsigned i = mid; i < count; ++i) {
-                newleaf->keys[i - mid] = keys[i];
-                newleaf->payloads[i - mid] = payloads[i];
-            }
+template <class Key, class Payload, class Latch, class Nodes>
+typename OLC_BTree<Key, Payload, Latch, Nodes>::BTreeLeaf* OLC_BTree<Key, Payload, Latch, Nodes>::findLeaf(TreeOperation op, Key k, uint64_t& versionLeaf) {
+    BTreeLeaf* leaf = nullptr;
+    Backoff backoff(backoffPolicy);
+    while (!tryFindLeaf(op, k, leaf, versionLeaf)) {
+        Latch::releaseReadLatches();
+        backoff.wait();
+    }
+    return leaf;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::tryLookup(Key k, Payload& result, bool& found) {
+    bool needRestart = false;
+    BTreeLeaf* leaf = nullptr;
+    uint64_t versionLeaf = 0;
+    if (!tryFindLeaf(TreeOperation::Lookup, k, leaf, versionLeaf)) return false;
 
-            newleaf->count = count - mid;
-            count = mid;
-            writeUnlock();
-            return newleaf;
+    found = leaf->find(k, result);
+    leaf->readUnlockOrRestart(versionLeaf, needRestart);
+    if (needRestart) return restartAt(TreeOperation::Lookup, height - 1, leaf);
+    return true;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::lookupShared(Key k, Payload& result) {
+    Backoff backoff(backoffPolicy);
+    NodeBase* node = nullptr;
+    while (true) {
+        node = root;
+        if (node->tryLockShared()) {
+            if (node == root) break;
+            node->unlockShared();
         }
+        backoff.wait();
     }
+
+    // Lock coupling, a child cannot be merged away while we hold its parent, so we only
+    // have to wait for the writer that holds it.
+    while (node->type == NodeType::BTreeInner) {
+        auto inner = static_cast<BTreeInner*>(node);
+        NodeBase* child = inner->childAt(inner->lowerBound(k));
+        while (!child->tryLockShared()) Backoff::pause();
+        inner->unlockShared();
+        node = child;
+    }
+
+    auto leaf = static_cast<BTreeLeaf*>(node);
+    bool found = leaf->find(k, result);
+    leaf->unlockShared();
+    return found;
 }
 
-// -------------------------------------------------------------------------------------
-unsigned BTreeInner::lowerBound(Key k) {
-    unsigned l = 0;
-    unsigned r = count;
-    while (l < r) {
-        unsigned mid = l + (r - l) / 2;
-        if (keys[mid] < k) {
-            l = mid + 1;
-        } else {
-            r = mid;
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::lookup(Key k, Payload& result) {
+    EpochGuard guard(epochManager);
+    bool found = false;
+    Backoff backoff(backoffPolicy);
+    unsigned restarts = 0;
+    while (!tryLookup(k, result, found)) {
+        Latch::releaseReadLatches();
+        // pessimistic readers only restart at obsolete nodes, they are not starved by writers
+        if constexpr (!Latch::pessimistic) {
+            if (sharedFallbackAfter > 0 && ++restarts >= sharedFallbackAfter) {
+                contention.countFallback(TreeOperation::Lookup);
+                return lookupShared(k, result);
+            }
         }
+        backoff.wait();
     }
-    return l;
+    Latch::releaseReadLatches();
+    return found;
 }
 
-BTreeInner* BTreeInner::split(Key& sep) {
-    bool restart = false;
-    while (true) {
-        writeLockOrRestart(restart);
-        if (!restart) {
-            BTreeInner* inner = new BTreeInner();
-            unsigned mid = count / 2;
-            sep = keys[mid];
-
-            for (unsigned i = mid + 1; i < count; ++i) {
-                inner->keys[i - mid - 1] = keys[i];
-                inner->children[i - mid - 1] = children[i];
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::prefetchNode(NodeBase* node) {
+    // the header and the first probes of the binary search in leaves and inner nodes
+    auto bytes = reinterpret_cast<const char*>(node);
+    __builtin_prefetch(bytes);
+    __builtin_prefetch(bytes + pageSize / 4);
+    __builtin_prefetch(bytes + 3 * pageSize / 4);
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::lookupBatch(const Key* keys, Payload* out, bool* found, size_t n) {
+    static constexpr size_t groupSize = 16;
+    if constexpr (Latch::pessimistic) {
+        // the interleaved lookups of a group would hold shared latches of each other's paths
+        for (size_t i = 0; i < n; ++i) found[i] = lookup(keys[i], out[i]);
+        return;
+    }
+    EpochGuard guard(epochManager);
+
+    struct Lookup {
+        NodeBase* node;
+        uint64_t version;
+        BTreeInner* parent;
+        uint64_t versionParent;
+        unsigned level;
+        bool active;
+    };
+    Lookup group[groupSize];
+
+    for (size_t offset = 0; offset < n; offset += groupSize) {
+        size_t size = std::min(groupSize, n - offset);
+        // lookups that hit a conflict are redone one by one after the group is finished
+        bool needsRetry[groupSize] = {};
+
+        NodeBase* rootNode = root;
+        for (size_t i = 0; i < size; ++i) {
+            group[i] = {rootNode, 0, nullptr, 0, 0, true};
+        }
+
+        size_t active = size;
+        while (active > 0) {
+            // Read the versions of the nodes prefetched in the previous round, validate the
+            // parents and either finish the lookup in the leaf or pick and prefetch the child.
+            for (size_t i = 0; i < size; ++i) {
+                Lookup& l = group[i];
+                if (!l.active) continue;
+                bool needRestart = false;
+                l.version = l.node->readLockOrRestart(needRestart);
+                if (!needRestart && l.parent) l.parent->readUnlockOrRestart(l.versionParent, needRestart);
+                if (!needRestart && !l.parent && l.node != root) needRestart = true;
+
+                if (!needRestart && l.node->type == NodeType::BTreeLeaf) {
+                    auto leaf = static_cast<BTreeLeaf*>(l.node);
+                    Key k = keys[offset + i];
+                    found[offset + i] = leaf->find(k, out[offset + i]);
+                    leaf->readUnlockOrRestart(l.version, needRestart);
+                    if (!needRestart) {
+                        l.active = false;
+                        --active;
+                        continue;
+                    }
+                } else if (!needRestart) {
+                    auto inner = static_cast<BTreeInner*>(l.node);
+                    NodeBase* child = inner->childAt(inner->lowerBound(keys[offset + i]));
+                    inner->checkOrRestart(l.version, needRestart);
+                    if (!needRestart) {
+                        prefetchNode(child);
+                        l.parent = inner;
+                        l.versionParent = l.version;
+                        l.node = child;
+                        ++l.level;
+                        continue;
+                    }
+                }
+                restartAt(TreeOperation::Lookup, l.level, l.node);
+                needsRetry[i] = true;
+                l.active = false;
+                --active;
             }
+        }
 
-            inner->count = count - mid - 1;
-            count = mid + 1;
-            writeUnlock();
-            return inner;
+        for (size_t i = 0; i < size; ++i) {
+            if (needsRetry[i]) found[offset + i] = lookup(keys[offset + i], out[offset + i]);
         }
     }
 }
 
-void BTreeInner::insert(Key k, NodeBase* child) {
-    bool restart = false;
+template <class Key, class Payload, class Latch, class Nodes>
+CoroTask OLC_BTree<Key, Payload, Latch, Nodes>::lookupAsync(Key k, Payload& result, bool& found) {
+    if constexpr (Latch::pessimistic) {
+        // shared latches must not be held across a suspension point
+        found = lookup(k, result);
+        co_return;
+    }
+    EpochGuard guard(epochManager);
     while (true) {
-        writeLockOrRestart(restart);
-        if (!restart) {
-            unsigned j = lowerBound(k);
-            for (unsigned i = count; i > j; --i) {
-                keys[i] = keys[i - 1];
-                children[i] = children[i - 1];
-            }
+        bool needRestart = false;
+        NodeBase* node = root;
+        uint64_t versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart || (node != root)) {
+            restartAt(TreeOperation::Lookup, 0, node);
+            co_await CoroYield{};
+            continue;
+        }
 
-            keys[j] = k;
-            children[j] = child;
-            ++count;
-            writeUnlock();
-            return;
+        unsigned depth = 0;
+        while (node->type == NodeType::BTreeInner) {
+            auto inner = static_cast<BTreeInner*>(node);
+            node = inner->childAt(inner->lowerBound(k));
+            inner->checkOrRestart(versionNode, needRestart);
+            if (needRestart) {
+                restartAt(TreeOperation::Lookup, depth, inner);
+                break;
+            }
+            prefetchNode(node);
+            co_await CoroYield{};
+            uint64_t versionChild = node->readLockOrRestart(needRestart);
+            if (needRestart) {
+                restartAt(TreeOperation::Lookup, depth + 1, node);
+                break;
+            }
+            inner->readUnlockOrRestart(versionNode, needRestart);
+            if (needRestart) {
+                restartAt(TreeOperation::Lookup, depth, inner);
+                break;
+            }
+            versionNode = versionChild;
+            ++depth;
         }
+        if (needRestart) continue;
+
+        auto leaf = static_cast<BTreeLeaf*>(node);
+        found = leaf->find(k, result);
+        leaf->readUnlockOrRestart(versionNode, needRestart);
+        if (!needRestart) co_return;
+        restartAt(TreeOperation::Lookup, depth, leaf);
     }
 }
 
-// -------------------------------------------------------------------------------------
+template <class Key, class Payload, class Latch, class Nodes>
+CoroTask OLC_BTree<Key, Payload, Latch, Nodes>::upsertAsync(Key k, Payload v) {
+    if constexpr (Latch::pessimistic) {
+        upsert(k, v);
+        co_return;
+    }
+    EpochGuard guard(epochManager);
+    // Only the descent suspends to pull the path into the cache, the upsert itself runs
+    // without suspending so no latch is ever held across a suspension point.
+    bool needRestart = false;
+    NodeBase* node = root;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    while (!needRestart && node->type == NodeType::BTreeInner) {
+        auto inner = static_cast<BTreeInner*>(node);
+        node = inner->childAt(inner->lowerBound(k));
+        inner->checkOrRestart(versionNode, needRestart);
+        if (needRestart) break;
+        prefetchNode(node);
+        co_await CoroYield{};
+        versionNode = node->readLockOrRestart(needRestart);
+    }
+    upsert(k, v);
+}
 
-// -------------------------------------------------------------------------------------
-// BTREE 
-// -------------------------------------------------------------------------------------
-void OLC_BTree::upsert(Key k, Payload v) {
-    bool restart = false;
-    while (true) {
-        uint64_t starttheread = root.load()->readLockOrRestart(restart);
-        NodeBase* curr = root.load();
-        NodeBase* parents = nullptr;
-
-        while (curr->type != NodeType::BTreeLeaf) {
-            BTreeInner* inner = static_cast<BTreeInner*>(curr);
-            unsigned j = inner->lowerBound(k);
-            parents = curr;
-            curr = inner->children[j];
-            curr->readLockOrRestart(restart);
-            if (restart) break;
-            parents->readUnlockOrRestart(starttheread, restart);
-            if (restart) break;
-            starttheread = curr->latchVersion.load();
-        }
-
-        if (!restart) {
-            BTreeLeaf* leaf = static_cast<BTreeLeaf*>(curr);
-            leaf->writeLockOrRestart(restart);
-            if (!restart) {
-                unsigned j = leaf->lowerBound(k);
-                if (j < leaf->count && leaf->keys[j] == k) {
-                    leaf->payloads[j] = v;
-                } else {
-                    leaf->insert(k, v);
-                }
-                leaf->writeUnlock();
+template <class Key, class Payload, class Latch, class Nodes>
+uint64_t OLC_BTree<Key, Payload, Latch, Nodes>::scan(Key start, uint64_t limit, Key* keysOut, Payload* payloadsOut) {
+    EpochGuard guard(epochManager);
+    uint64_t produced = 0;
+    Key resume = start;
+    bool resumeCopied = false; // continue behind resume, it is the last key we copied
+    uint64_t versionLeaf = 0;
+
+    // Descends from the root again to the leaf with the entries behind resume. Re-reading
+    // only the leaf that changed is not enough, a rebalance can move the first entries of
+    // a leaf into its left sibling, which we already copied.
+    auto restartScan = [&](BTreeLeaf* leaf) {
+        restartAt(TreeOperation::Scan, height - 1, leaf);
+        return findLeaf(TreeOperation::Scan, resume, versionLeaf);
+    };
+
+    BTreeLeaf* leaf = (limit > 0) ? findLeaf(TreeOperation::Scan, resume, versionLeaf) : nullptr;
+    while (leaf) {
+        bool needRestart = false;
+        bool writeLocked = false;
+        if (!leaf->isSorted()) {
+            // sorted once, this and later scans can copy the entries in order
+            leaf->upgradeToWriteLockOrRestart(versionLeaf, needRestart);
+            if (needRestart) {
+                leaf = restartScan(leaf);
+                continue;
             }
-            leaf->readUnlockOrRestart(starttheread, restart);
+            leaf->sortEntries();
+            writeLocked = true;
+        }
+        uint64_t n = leaf->copyEntries(resume, resumeCopied, limit - produced, keysOut + produced,
+                                       payloadsOut ? payloadsOut + produced : nullptr);
+        // Lock coupling, the next leaf is read locked before this one is validated. Entries
+        // that move from the next leaf into this one change both, so either this leaf fails
+        // its validation or the next one fails when we copy it.
+        BTreeLeaf* next = leaf->next;
+        uint64_t versionNext = 0;
+        bool nextLocked = false;
+        if (next && produced + n < limit) {
+            versionNext = next->readLockOrRestart(needRestart);
+            nextLocked = !needRestart;
+        }
+        needRestart = false;
+        if (writeLocked) {
+            leaf->writeUnlock();
+        } else {
+            leaf->readUnlockOrRestart(versionLeaf, needRestart);
+        }
+        if (needRestart) {
+            leaf = restartScan(leaf);
+            continue;
         }
 
-        curr->readUnlockOrRestart(starttheread, restart);
-        if (!restart) {
-            return;
+        produced += n;
+        if (produced == limit || !next) break;
+        if (n > 0) {
+            resume = keysOut[produced - 1];
+            resumeCopied = true;
+        }
+        if (!nextLocked) {
+            // A writer holds the next leaf, it may move entries into the leaf we just copied.
+            // The epoch guard keeps the next leaf allocated while we wait for the writer.
+            Backoff backoff(backoffPolicy);
+            while (next->isLocked(next->currentVersion())) backoff.wait();
+            leaf = restartScan(next);
+            continue;
         }
-        std::cout << "Restarting upsert function..." << std::endl;
+        leaf = next;
+        versionLeaf = versionNext;
     }
+    return produced;
 }
 
-bool OLC_BTree::lookup(Key k, Payload& result) {
-    bool restart = false;
-    while (true) {
-        uint64_t starttheread = root.load()->readLockOrRestart(restart);
-        NodeBase* curr = root.load();
-
-        while (curr->type != NodeType::BTreeLeaf) {
-            BTreeInner* inner = static_cast<BTreeInner*>(curr);
-            unsigned j = inner->lowerBound(k);
-            curr = inner->children[j];
-            curr->readLockOrRestart(restart);
-            if (restart) break;
-            curr->readUnlockOrRestart(starttheread, restart);
-            if (restart) break;
-            starttheread = curr->latchVersion.load();
-        }
-
-        if (!restart) {
-            BTreeLeaf* leaf = static_cast<BTreeLeaf*>(curr);
-            leaf->readLockOrRestart(restart);
-            if (!restart) {
-                unsigned j = leaf->lowerBound(k);
-                if (j < leaf->count && leaf->keys[j] == k) {
-                    result = leaf->payloads[j];
-                    leaf->readUnlockOrRestart(starttheread, restart);
-                    curr->readUnlockOrRestart(starttheread, restart);
-                    return true;
-                }
-                leaf->readUnlockOrRestart(starttheread, restart);
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::mergeInner(BTreeInner* parent, uint64_t& versionParent, unsigned pos, BTreeInner* inner, uint64_t& versionNode,
+                                                unsigned depth, uint64_t versionReplica) {
+    bool needRestart = false;
+    bool topLevel = false;
+    if (!lockStructureChange(parent, versionParent, inner, versionNode, depth, versionReplica, topLevel, needRestart)) return false;
+
+    // merge with the right sibling, the last child merges with its left sibling instead
+    unsigned leftPos = (pos < parent->count) ? pos : pos - 1;
+    BTreeInner* sibling = static_cast<BTreeInner*>(parent->childAt((leftPos == pos) ? pos + 1 : leftPos));
+    sibling->writeLockOrRestart(needRestart);
+    if (needRestart) {
+        inner->writeUnlock();
+        parent->writeUnlock();
+        finishStructureChange(topLevel);
+        return false;
+    }
+
+    auto left = static_cast<BTreeInner*>(parent->childAt(leftPos));
+    auto right = static_cast<BTreeInner*>(parent->childAt(leftPos + 1));
+    if (left->canMerge(right)) {
+        left->merge(parent->keyAt(leftPos), right);
+        parent->removeAt(leftPos);
+        left->writeUnlock();
+        right->writeUnlockObsolete();
+        retireNode(right);
+    } else {
+        parent->setKeyAt(leftPos, left->rebalance(parent->keyAt(leftPos), right));
+        left->writeUnlock();
+        right->writeUnlock();
+    }
+    parent->writeUnlock();
+    finishStructureChange(topLevel);
+    return true;
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::mergeLeaf(BTreeInner* parent, uint64_t versionParent, unsigned pos, BTreeLeaf* leaf,
+                                               uint64_t versionReplica) {
+    bool needRestart = false;
+    if (parent->count == 0) {
+        leaf->writeUnlock();
+        return;
+    }
+    // the leaf is latched already, shared readers of the parent may be waiting for it
+    parent->upgradeToWriteLockNoWaitOrRestart(versionParent, needRestart);
+    if (needRestart) {
+        leaf->writeUnlock();
+        return;
+    }
+    if (replicaRoots && replicaVersion != versionReplica) {
+        // the parent could have become part of the replicated levels
+        parent->writeUnlock();
+        leaf->writeUnlock();
+        return;
+    }
+
+    unsigned leftPos = (pos < parent->count) ? pos : pos - 1;
+    BTreeLeaf* sibling = static_cast<BTreeLeaf*>(parent->childAt((leftPos == pos) ? pos + 1 : leftPos));
+    sibling->writeLockOrRestart(needRestart);
+    if (needRestart) {
+        parent->writeUnlock();
+        leaf->writeUnlock();
+        return;
+    }
+
+    auto left = static_cast<BTreeLeaf*>(parent->childAt(leftPos));
+    auto right = static_cast<BTreeLeaf*>(parent->childAt(leftPos + 1));
+    if (left->canMerge(right)) {
+        left->merge(right);
+        parent->removeAt(leftPos);
+        left->writeUnlock();
+        right->writeUnlockObsolete();
+        retireNode(right);
+    } else {
+        parent->setKeyAt(leftPos, left->rebalance(right));
+        left->writeUnlock();
+        right->writeUnlock();
+    }
+    parent->writeUnlock();
+}
+
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::tryRemove(Key k, bool& found, bool& needRestart) {
+    needRestart = false;
+    uint64_t versionReplica = replicaVersion;
+    NodeBase* node = root;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root)) return restartAt(TreeOperation::Remove, 0, node);
+
+    BTreeInner* parent = nullptr;
+    uint64_t versionParent = 0;
+    unsigned pos = 0;
+    unsigned depth = 0;
+
+    while (node->type == NodeType::BTreeInner) {
+        auto inner = static_cast<BTreeInner*>(node);
+
+        if (!parent && inner->count == 0) {
+            // the root has a single child left, it becomes the new root
+            bool topLevel = false;
+            if (!lockStructureChange(nullptr, versionParent, node, versionNode, 0, versionReplica, topLevel, needRestart)) {
+                return restartAt(TreeOperation::Remove, 0, node);
             }
-            curr->readUnlockOrRestart(starttheread, restart);
+            root = inner->childAt(0);
+            --height;
+            inner->writeUnlockObsolete();
+            retireNode(inner);
+            finishStructureChange(topLevel);
+            return false;
         }
 
-        if (!restart) {
+        // Merge eagerly on the way down, so a parent never underflows because of a child merge.
+        if (parent && inner->isUnderfull() && parent->count > 0) {
+            needRestart = !mergeInner(parent, versionParent, pos, inner, versionNode, depth, versionReplica);
+            if (needRestart) return restartAt(TreeOperation::Remove, depth, inner);
             return false;
         }
+
+        if (parent) {
+            parent->readUnlockOrRestart(versionParent, needRestart);
+            if (needRestart) return restartAt(TreeOperation::Remove, depth - 1, parent);
+        }
+
+        parent = inner;
+        versionParent = versionNode;
+        ++depth;
+
+        pos = inner->lowerBound(k);
+        node = inner->childAt(pos);
+        inner->checkOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(TreeOperation::Remove, depth - 1, inner);
+        versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart) return restartAt(TreeOperation::Remove, depth, node);
     }
-}
 
-void OLC_BTree::makeRoot(Key k, NodeBase* leftChild, NodeBase* rightChild) {
-    bool restart = false;
-    while (true) {
-        uint64_t starttheread = root.load()->readLockOrRestart(restart);
-        BTreeInner* newroot = new BTreeInner();
-        newroot->insert(k, leftChild);
-        newroot->insert(k, rightChild);
-
-        root.load()->writeLockOrRestart(restart);
-        if (!restart) {
-            root.store(newroot);
-            root.load()->writeUnlock();
-            root.load()->readUnlockOrRestart(starttheread, restart);
-            return;
+    // The parent was validated before the leaf was latched, a rebalance in between can have
+    // moved k to a sibling. The parent stays latched for mergeLeaf, so it is only checked.
+    auto leaf = static_cast<BTreeLeaf*>(node);
+    if (!leaf->contains(k)) {
+        found = false;
+        leaf->readUnlockOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(TreeOperation::Remove, depth, leaf);
+        if (parent) {
+            parent->checkOrRestart(versionParent, needRestart);
+            if (needRestart) return restartAt(TreeOperation::Remove, depth - 1, parent);
         }
+        return true;
+    }
 
-        delete newroot;
-        root.load()->readUnlockOrRestart(starttheread, restart);
+    leaf->upgradeToWriteLockOrRestart(versionNode, needRestart);
+    if (needRestart) return restartAt(TreeOperation::Remove, depth, leaf);
+    if (parent) {
+        parent->checkOrRestart(versionParent, needRestart);
+        if (needRestart) {
+            leaf->writeUnlock();
+            return restartAt(TreeOperation::Remove, depth - 1, parent);
+        }
     }
+    found = leaf->remove(k);
+    if (parent && leaf->isUnderfull()) {
+        // unlocks the leaf
+        mergeLeaf(parent, versionParent, pos, leaf, versionReplica);
+    } else {
+        leaf->writeUnlock();
+    }
+    return true;
 }
 
-int main() {
-    // Create an instance of the B-tree
-    OLC_BTree btree;
+template <class Key, class Payload, class Latch, class Nodes>
+bool OLC_BTree<Key, Payload, Latch, Nodes>::remove(Key k) {
+    EpochGuard guard(epochManager);
+    bool found = false;
+    bool needRestart = false;
+    Backoff backoff(backoffPolicy);
+    while (!tryRemove(k, found, needRestart)) {
+        Latch::releaseReadLatches();
+        if (needRestart) backoff.wait();
+    }
+    Latch::releaseReadLatches();
+    return found;
+}
 
-    // Test upsert function
-    std::cout << "Testing upsert function..." << std::endl;
+template <class Key, class Payload, class Latch, class Nodes>
+uint64_t OLC_BTree<Key, Payload, Latch, Nodes>::nodesForLevel(uint64_t entries, uint64_t perNode) {
+    return std::max<uint64_t>(1, (entries + perNode - 1) / perNode);
+}
 
-    // Insert some key-value pairs
-    btree.upsert(10, 100);
-    btree.upsert(20, 200);
-    btree.upsert(30, 300);
+template <class Key, class Payload, class Latch, class Nodes>
+std::vector<uint64_t> OLC_BTree<Key, Payload, Latch, Nodes>::leafBounds(const Key* keys, uint64_t n, double fillFactor) {
+    auto entriesFor = [fillFactor](uint64_t capacity) { return std::max<uint64_t>(1, fillFactor * capacity); };
+    std::vector<uint64_t> bounds;
+    if constexpr (requires(Key k) { BTreeLeaf::capacityForRange(k, k); }) {
+        // Every leaf starts with the capacity of its first key alone and shrinks to the capacity
+        // of the keys it would get until they fit, so only leaves with wide keys lose entries.
+        for (uint64_t from = 0; from < n;) {
+            bounds.push_back(from);
+            uint64_t entries = entriesFor(BTreeLeaf::capacityForRange(keys[from], keys[from]));
+            for (;;) {
+                uint64_t to = std::min(n, from + entries);
+                uint64_t fitting = entriesFor(BTreeLeaf::capacityForRange(keys[from], keys[to - 1]));
+                if (fitting >= to - from) {
+                    from = to;
+                    break;
+                }
+                entries = fitting;
+            }
+        }
+    } else {
+        uint64_t leafCount = nodesForLevel(n, entriesFor(BTreeLeaf::maxEntries));
+        for (uint64_t i = 0; i < leafCount; ++i) bounds.push_back(i * n / leafCount);
+    }
+    bounds.push_back(n);
+    return bounds;
+}
 
-    // Update an existing key-value pair
-    btree.upsert(20, 250);
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::buildLeaves(const Key* keys, const Payload* payloads, uint64_t n,
+                                                 const std::vector<uint64_t>& bounds, uint64_t begin, uint64_t end,
+                                                 std::vector<NodeBase*>& level, std::vector<Key>& maxKeys) {
+    uint64_t leafCount = level.size();
+    BTreeLeaf* previous = nullptr;
+    for (uint64_t i = begin; i < end; ++i) {
+        uint64_t from = bounds[i];
+        uint64_t to = bounds[i + 1];
+        // the separator after a leaf lies between its largest key and the first key of the
+        // next leaf, the last leaf covers all larger keys
+        Key lower = (from > 0) ? shortestSeparator(keys[from - 1], keys[from]) : Key();
+        maxKeys[i] = (to > from) ? ((to < n) ? shortestSeparator(keys[to - 1], keys[to]) : keys[to - 1]) : Key();
+        auto leaf = newNode<BTreeLeaf>();
+        leaf->load(keys + from, payloads ? payloads + from : nullptr, to - from, (from > 0) ? &lower : nullptr,
+                   (i + 1 < leafCount) ? &maxKeys[i] : nullptr);
+        if (previous) previous->next = leaf;
+        previous = leaf;
+        level[i] = leaf;
+    }
+}
 
-    // Insert a new key-value pair
-    btree.upsert(40, 400);
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::buildInnerLevel(const std::vector<NodeBase*>& children, const std::vector<Key>& childMaxKeys,
+                                                     uint64_t begin, uint64_t end, std::vector<NodeBase*>& level,
+                                                     std::vector<Key>& maxKeys) {
+    uint64_t m = children.size();
+    uint64_t nodeCount = level.size();
+    for (uint64_t i = begin; i < end; ++i) {
+        uint64_t from = i * m / nodeCount;
+        uint64_t to = (i + 1) * m / nodeCount;
+        auto inner = newNode<BTreeInner>();
+        // the separator of a child is the one after the largest key in its subtree
+        inner->load(children.data() + from, childMaxKeys.data() + from, to - from,
+                    (from > 0) ? childMaxKeys.data() + from - 1 : nullptr, (i + 1 < nodeCount) ? childMaxKeys.data() + to - 1 : nullptr);
+        level[i] = inner;
+        maxKeys[i] = childMaxKeys[to - 1];
+    }
+}
 
-    // Look up some key-value pairs
-    Payload result;
-    bool found;
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::bulkLoad(const Key* keys, const Payload* payloads, size_t n, double fillFactor) {
+    bulkLoadParallel(keys, payloads, n, fillFactor, 1);
+}
 
-    found = btree.lookup(10, result);
-    std::cout << "Key 10 found: " << (found ? "true" : "false") << ", Value: " << result << std::endl;
+template <class Key, class Payload, class Latch, class Nodes>
+void OLC_BTree<Key, Payload, Latch, Nodes>::bulkLoadParallel(const Key* keys, const Payload* payloads, size_t n, double fillFactor,
+                                                      unsigned numThreads) {
+    {
+        EpochGuard guard(epochManager);
+        NodeBase* oldRoot = root;
+        if (oldRoot->type != NodeType::BTreeLeaf || oldRoot->count > 0) {
+            for (size_t i = 0; i < n; ++i) upsert(keys[i], payloads ? payloads[i] : Payload());
+            return;
+        }
+    }
+    if (n == 0) return;
 
-    found = btree.lookup(20, result);
-    std::cout << "Key 20 found: " << (found ? "true" : "false") << ", Value: " << result << std::endl;
+    fillFactor = std::clamp(fillFactor, 0.0, 1.0);
+    std::vector<uint64_t> bounds = leafBounds(keys, n, fillFactor);
+    uint64_t perInner = std::max<uint64_t>(2, fillFactor * BTreeInner::maxEntries);
 
-    found = btree.lookup(30, result);
-    std::cout << "Key 30 found: " << (found ? "true" : "false") << ", Value: " << result << std::endl;
+    // The shape of the tree is known once the leaves are, so all levels are sized upfront.
+    std::vector<std::vector<NodeBase*>> levels;
+    std::vector<std::vector<Key>> maxKeys;
+    for (uint64_t size = bounds.size() - 1;; size = nodesForLevel(size, perInner)) {
+        levels.emplace_back(size);
+        maxKeys.emplace_back(size);
+        if (size == 1) break;
+    }
 
-    found = btree.lookup(40, result);
-    std::cout << "Key 40 found: " << (found ? "true" : "false") << ", Value: " << result << std::endl;
+    // Every worker builds the subtrees below a range of nodes of the lowest level that still
+    // has a node per worker. The levels above are built once the workers are done.
+    numThreads = std::max(1u, numThreads);
+    unsigned splitLevel = 0;
+    while (splitLevel + 1 < levels.size() && levels[splitLevel + 1].size() >= numThreads) ++splitLevel;
+    numThreads = std::min<uint64_t>(numThreads, levels[splitLevel].size());
 
-    // Test with a key that doesn't exist
-    found = btree.lookup(50, result);
-    std::cout << "Key 50 found: " << (found ? "true" : "false") << std::endl;
+    auto buildSubtrees = [&](unsigned worker) {
+        // map the node range of the worker on the split level down to the leaves
+        std::vector<uint64_t> begin(splitLevel + 1), end(splitLevel + 1);
+        begin[splitLevel] = worker * levels[splitLevel].size() / numThreads;
+        end[splitLevel] = (worker + 1) * levels[splitLevel].size() / numThreads;
+        for (unsigned l = splitLevel; l > 0; --l) {
+            begin[l - 1] = begin[l] * levels[l - 1].size() / levels[l].size();
+            end[l - 1] = end[l] * levels[l - 1].size() / levels[l].size();
+        }
+        buildLeaves(keys, payloads, n, bounds, begin[0], end[0], levels[0], maxKeys[0]);
+        for (unsigned l = 1; l <= splitLevel; ++l) {
+            buildInnerLevel(levels[l - 1], maxKeys[l - 1], begin[l], end[l], levels[l], maxKeys[l]);
+        }
+        return begin[0];
+    };
 
-    return 0;
-}
+    std::vector<std::thread> workers;
+    std::vector<uint64_t> firstLeaf(numThreads);
+    for (unsigned worker = 1; worker < numThreads; ++worker) {
+        workers.emplace_back([&, worker]() { firstLeaf[worker] = buildSubtrees(worker); });
+    }
+    firstLeaf[0] = buildSubtrees(0);
+    for (auto& worker : workers) worker.join();
 
-//     std::cout << "Tree height: " << btree.getHeight() << std::endl;
+    // stitch the leaf runs of the workers together
+    for (unsigned worker = 1; worker < numThreads; ++worker) {
+        auto last = static_cast<BTreeLeaf*>(levels[0][firstLeaf[worker] - 1]);
+        last->next = static_cast<BTreeLeaf*>(levels[0][firstLeaf[worker]]);
+    }
+    for (unsigned l = splitLevel + 1; l < levels.size(); ++l) {
+        buildInnerLevel(levels[l - 1], maxKeys[l - 1], 0, levels[l].size(), levels[l], maxKeys[l]);
+    }
+
+    leafArena.free(root);
+    if (replicaRoots) replicaMutex.lock();
+    root = levels.back()[0];
+    height = levels.size();
+    if (replicaRoots) {
+        rebuildReplicas();
+        replicaMutex.unlock();
+    }
+}
 
-//     return 0;
-// }
+// -------------------------------------------------------------------------------------
+template struct BTreeLeaf<uint64_t, uint64_t, OptLatch>; // used on its own by the leaf benchmarks
+template class OLC_BTree<uint64_t, uint64_t, OptLatch>;
+template class OLC_BTree<uint64_t, uint64_t, RWLatch>;
+template class OLC_BTree<uint64_t, uint64_t, NoLatch>;
+template class OLC_BTree<uint64_t, NoPayload, OptLatch>;
+template class OLC_BTree<uint32_t, uint32_t, OptLatch>;
+template class OLC_BTree<uint32_t, uint64_t, OptLatch>;
+template class OLC_BTree<uint32_t, NoPayload, OptLatch>;
+template class OLC_BTree<Key128, uint64_t, OptLatch>;
+template class OLC_BTree<Key128, NoPayload, OptLatch>;
+template class OLC_BTree<uint64_t, uint64_t, OptLatch, PrefixNodes>;
+template class OLC_BTree<uint64_t, NoPayload, OptLatch, PrefixNodes>;
+template class OLC_BTree<uint32_t, uint32_t, OptLatch, PrefixNodes>;
+template class OLC_BTree<uint64_t, uint64_t, OptLatch, CompactNodes>;
+template class OLC_BTree<uint32_t, uint32_t, OptLatch, CompactNodes>;
+template class OLC_BTree<uint64_t, uint64_t, OptLatch, FingerprintNodes>;
+template class OLC_BTree<uint64_t, NoPayload, OptLatch, FingerprintNodes>;
+template class OLC_BTree<uint32_t, uint32_t, OptLatch, FingerprintNodes>;
+template class OLC_BTree<uint64_t, uint64_t, OptLatch, GappedNodes>;
+template class OLC_BTree<uint64_t, NoPayload, OptLatch, GappedNodes>;
+template class OLC_BTree<uint32_t, uint32_t, OptLatch, GappedNodes>;
@@ -0,0 +1,471 @@
+#include "OLC_StringBTree.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// -------------------------------------------------------------------------------------
+// STRING NODES
+// -------------------------------------------------------------------------------------
+uint32_t StringNode::head(std::string_view k) {
+    uint8_t bytes[4] = {};
+    std::memcpy(bytes, k.data(), std::min<size_t>(k.size(), sizeof(bytes)));
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+// An optimistic reader may see a slot that is being rewritten, so the entry is clamped to
+// the page and never read outside of it. The version check afterwards discards the result.
+std::string_view StringNode::keyAt(unsigned pos) const {
+    unsigned offset = std::min<unsigned>(slots[pos].offset, pageSize - valueSize);
+    unsigned length = std::min<unsigned>(slots[pos].length, pageSize - valueSize - offset);
+    return {reinterpret_cast<const char*>(this) + offset, length};
+}
+
+uint64_t StringNode::valueAt(unsigned pos) const {
+    std::string_view key = keyAt(pos);
+    uint64_t value;
+    std::memcpy(&value, key.data() + key.size(), valueSize);
+    return value;
+}
+
+void StringNode::setValueAt(unsigned pos, uint64_t value) {
+    std::memcpy(reinterpret_cast<uint8_t*>(this) + slots[pos].offset + slots[pos].length, &value, valueSize);
+}
+
+void StringNode::setChildAt(unsigned pos, StringNode* child) {
+    if (pos == count) {
+        link = child;
+    } else {
+        setValueAt(pos, reinterpret_cast<uint64_t>(child));
+    }
+}
+
+int StringNode::compare(unsigned pos, std::string_view k, uint32_t kHead) const {
+    uint32_t slotHead = slots[pos].head;
+    if (slotHead != kHead) return (slotHead < kHead) ? -1 : 1;
+    // the first bytes are equal or padded, only the full keys can tell
+    return keyAt(pos).compare(k);
+}
+
+unsigned StringNode::lowerBound(std::string_view k, bool& found) const {
+    uint32_t kHead = head(k);
+    unsigned l = 0;
+    unsigned r = slotCount();
+    while (l < r) {
+        unsigned mid = l + (r - l) / 2;
+        if (compare(mid, k, kHead) < 0) {
+            l = mid + 1;
+        } else {
+            r = mid;
+        }
+    }
+    found = (l < slotCount()) && (compare(l, k, kHead) == 0);
+    return l;
+}
+
+void StringNode::insertAt(unsigned pos, std::string_view k, uint64_t value) {
+    if (freeSpace() < spaceNeeded(k.size())) compact();
+    unsigned entrySize = k.size() + valueSize;
+    heapStart -= entrySize;
+    heapUsed += entrySize;
+    std::memcpy(reinterpret_cast<uint8_t*>(this) + heapStart, k.data(), k.size());
+    std::memmove(slots + pos + 1, slots + pos, sizeof(Slot) * (count - pos));
+    slots[pos] = {heapStart, static_cast<uint16_t>(k.size()), head(k)};
+    ++count;
+    setValueAt(pos, value);
+}
+
+void StringNode::removeAt(unsigned pos) {
+    heapUsed -= slots[pos].length + valueSize;
+    std::memmove(slots + pos, slots + pos + 1, sizeof(Slot) * (count - pos - 1));
+    --count;
+}
+
+void StringNode::insertSeparator(std::string_view sep, StringNode* right) {
+    bool found = false;
+    unsigned pos = lowerBound(sep, found);
+    // the split node keeps the lower half, so it has to stay left of the separator
+    insertAt(pos, sep, reinterpret_cast<uint64_t>(childAt(pos)));
+    setChildAt(pos + 1, right);
+}
+
+void StringNode::copyEntries(StringNode* to, unsigned begin, unsigned end) const {
+    for (unsigned pos = begin; pos < end; ++pos) {
+        to->insertAt(to->count, keyAt(pos), valueAt(pos));
+    }
+}
+
+void StringNode::keepFirst(unsigned n) {
+    // rebuild in a scratch node, the latch of this node must not be touched
+    StringNode scratch(type);
+    copyEntries(&scratch, 0, n);
+    std::memcpy(slots, scratch.slots, sizeof(slots));
+    count = scratch.count;
+    heapStart = scratch.heapStart;
+    heapUsed = scratch.heapUsed;
+}
+
+void StringNode::compact() {
+    keepFirst(count);
+}
+
+unsigned StringNode::splitPos() const {
+    // the first position at which at least half of the bytes are on the left
+    unsigned half = (count * sizeof(Slot) + heapUsed) / 2;
+    unsigned bytes = 0;
+    unsigned pos = 0;
+    while (pos < count && bytes < half) bytes += spaceNeeded(slots[pos++].length);
+    unsigned lowest = isLeaf() ? 1 : 2;
+    return std::clamp(pos, lowest, count - 1u);
+}
+
+std::string_view StringNode::separator(unsigned pos) const {
+    std::string_view left = keyAt(pos - 1);
+    if (!isLeaf()) return left;
+    // Any key in [left, right) separates the halves. The shortest prefix of right that is
+    // larger than left is one, unless it is right itself.
+    std::string_view right = keyAt(pos);
+    size_t common = 0;
+    while (common < left.size() && left[common] == right[common]) ++common;
+    return (common + 1 < right.size()) ? right.substr(0, common + 1) : left;
+}
+
+StringNode* StringNode::split(std::string& sep, NodeArena& arena) {
+    auto right = new (arena.allocate()) StringNode(type);
+    unsigned pos = splitPos();
+    sep = separator(pos);
+    if (isLeaf()) {
+        // left keeps [0, pos)
+        copyEntries(right, pos, count);
+        right->link = link;
+        link = right;
+        keepFirst(pos);
+    } else {
+        // keys[pos - 1] moves up, its child becomes the rightmost child of the left node
+        copyEntries(right, pos, count);
+        right->link = link;
+        link = childAt(pos - 1);
+        keepFirst(pos - 1);
+    }
+    return right;
+}
+
+// -------------------------------------------------------------------------------------
+// STRING BTREE
+// -------------------------------------------------------------------------------------
+OLC_StringBTree::OLC_StringBTree(NodeAllocMode allocMode) : arena(allocMode) {
+    root = newNode(NodeType::BTreeLeaf);
+    height = 1;
+}
+
+void OLC_StringBTree::makeRoot(std::string_view sep, StringNode* leftChild, StringNode* rightChild) {
+    // The caller holds the write latch of the old root, so nobody else can replace it.
+    auto newRoot = newNode(NodeType::BTreeInner);
+    newRoot->insertAt(0, sep, reinterpret_cast<uint64_t>(leftChild));
+    newRoot->link = rightChild;
+    root = newRoot;
+    ++height;
+}
+
+bool OLC_StringBTree::lockParentAndNode(StringNode* parent, uint64_t& versionParent, StringNode* node,
+                                        uint64_t& versionNode, bool& needRestart) {
+    if (parent) {
+        parent->upgradeToWriteLockOrRestart(versionParent, needRestart);
+        if (needRestart) return false;
+    }
+    node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+    if (needRestart) {
+        if (parent) parent->writeUnlock();
+        return false;
+    }
+    if (!parent && (node != root)) {
+        // the root was replaced after we started the descent
+        node->writeUnlock();
+        needRestart = true;
+        return false;
+    }
+    return true;
+}
+
+bool OLC_StringBTree::restartAt(TreeOperation op, unsigned level, StringNode* node) {
+    uint64_t version = node->currentVersion();
+    contention.count(op, level, node->isLocked(version) ? RestartCause::Locked : RestartCause::VersionChanged);
+    return false;
+}
+
+bool OLC_StringBTree::tryUpsert(std::string_view k, Payload v, bool& needRestart) {
+    needRestart = false;
+    StringNode* node = root;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root)) return restartAt(TreeOperation::Upsert, 0, node);
+
+    StringNode* parent = nullptr;
+    uint64_t versionParent = 0;
+    unsigned depth = 0;
+    bool found = false;
+
+    while (!node->isLeaf()) {
+        if (parent) {
+            parent->readUnlockOrRestart(versionParent, needRestart);
+            if (needRestart) return restartAt(TreeOperation::Upsert, depth - 1, parent);
+        }
+
+        parent = node;
+        versionParent = versionNode;
+        ++depth;
+
+        node = parent->childAt(parent->lowerBound(k, found));
+        parent->checkOrRestart(versionParent, needRestart);
+        if (needRestart) return restartAt(TreeOperation::Upsert, depth - 1, parent);
+        versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart) return restartAt(TreeOperation::Upsert, depth, node);
+    }
+
+    unsigned pos = node->lowerBound(k, found);
+    if (!found && !node->canInsert(k.size())) {
+        // Inner nodes are only split when a separator does not fit, splitting them eagerly
+        // would have to keep room for a key of maxKeyLength in every inner node.
+        if (!lockParentAndNode(parent, versionParent, node, versionNode, needRestart)) {
+            return restartAt(TreeOperation::Upsert, depth, node);
+        }
+        std::string sep(node->separator(node->splitPos()));
+        if (parent && !parent->canInsert(sep.size())) {
+            node->writeUnlock();
+            parent->writeUnlock();
+            trySplitInner(parent, k, sep.size());
+            return false;
+        }
+        StringNode* right = node->split(sep, arena);
+        if (parent) {
+            parent->insertSeparator(sep, right);
+        } else {
+            makeRoot(sep, node, right);
+        }
+        node->writeUnlock();
+        if (parent) parent->writeUnlock();
+        // descend again from the root, this is not a conflict
+        return false;
+    }
+
+    node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+    if (needRestart) return restartAt(TreeOperation::Upsert, depth, node);
+    if (parent) {
+        parent->readUnlockOrRestart(versionParent, needRestart);
+        if (needRestart) {
+            node->writeUnlock();
+            return restartAt(TreeOperation::Upsert, depth - 1, parent);
+        }
+    }
+    if (found) {
+        node->setValueAt(pos, v);
+    } else {
+        node->insertAt(pos, k, v);
+    }
+    node->writeUnlock();
+    return true;
+}
+
+bool OLC_StringBTree::trySplitInner(StringNode* target, std::string_view k, unsigned keyLength) {
+    bool needRestart = false;
+    StringNode* node = root;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root)) return restartAt(TreeOperation::Upsert, 0, node);
+
+    StringNode* parent = nullptr;
+    uint64_t versionParent = 0;
+    unsigned depth = 0;
+    while (node != target) {
+        // target was split or moved off the path to k in the meantime
+        if (node->isLeaf()) return false;
+        if (parent) {
+            parent->readUnlockOrRestart(versionParent, needRestart);
+            if (needRestart) return restartAt(TreeOperation::Upsert, depth - 1, parent);
+        }
+
+        parent = node;
+        versionParent = versionNode;
+        ++depth;
+
+        bool found = false;
+        node = parent->childAt(parent->lowerBound(k, found));
+        parent->checkOrRestart(versionParent, needRestart);
+        if (needRestart) return restartAt(TreeOperation::Upsert, depth - 1, parent);
+        versionNode = node->readLockOrRestart(needRestart);
+        if (needRestart) return restartAt(TreeOperation::Upsert, depth, node);
+    }
+
+    if (!lockParentAndNode(parent, versionParent, node, versionNode, needRestart)) {
+        return restartAt(TreeOperation::Upsert, depth, node);
+    }
+    if (node->canInsert(keyLength)) {
+        node->writeUnlock();
+        if (parent) parent->writeUnlock();
+        return true;
+    }
+    std::string sep(node->separator(node->splitPos()));
+    if (parent && !parent->canInsert(sep.size())) {
+        node->writeUnlock();
+        parent->writeUnlock();
+        return trySplitInner(parent, k, sep.size());
+    }
+    StringNode* right = node->split(sep, arena);
+    if (parent) {
+        parent->insertSeparator(sep, right);
+    } else {
+        makeRoot(sep, node, right);
+    }
+    node->writeUnlock();
+    if (parent) parent->writeUnlock();
+    return true;
+}
+
+void OLC_StringBTree::upsert(std::string_view k, Payload v) {
+    if (k.size() > maxKeyLength) throw std::length_error("OLC_StringBTree: key longer than maxKeyLength");
+    bool needRestart = false;
+    Backoff backoff(backoffPolicy);
+    while (!tryUpsert(k, v, needRestart)) {
+        if (needRestart) backoff.wait();
+    }
+}
+
+bool OLC_StringBTree::tryFindLeaf(TreeOperation op, std::string_view k, StringNode*& leaf, uint64_t& versionLeaf) {
+    bool needRestart = false;
+    StringNode* node = root;
+    uint64_t versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root)) return restartAt(op, 0, node);
+
+    unsigned depth = 0;
+    while (!node->isLeaf()) {
+        auto inner = node;
+        bool found = false;
+        node = inner->childAt(inner->lowerBound(k, found));
+        inner->checkOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(op, depth, inner);
+        uint64_t versionChild = node->readLockOrRestart(needRestart);
+        if (needRestart) return restartAt(op, depth + 1, node);
+        inner->readUnlockOrRestart(versionNode, needRestart);
+        if (needRestart) return restartAt(op, depth, inner);
+        versionNode = versionChild;
+        ++depth;
+    }
+
+    leaf = node;
+    versionLeaf = versionNode;
+    return true;
+}
+
+StringNode* OLC_StringBTree::findLeaf(TreeOperation op, std::string_view k, uint64_t& versionLeaf) {
+    StringNode* leaf = nullptr;
+    Backoff backoff(backoffPolicy);
+    while (!tryFindLeaf(op, k, leaf, versionLeaf)) {
+        backoff.wait();
+    }
+    return leaf;
+}
+
+bool OLC_StringBTree::tryLookup(std::string_view k, Payload& result, bool& found) {
+    bool needRestart = false;
+    StringNode* leaf = nullptr;
+    uint64_t versionLeaf = 0;
+    if (!tryFindLeaf(TreeOperation::Lookup, k, leaf, versionLeaf)) return false;
+
+    unsigned pos = leaf->lowerBound(k, found);
+    if (found) result = leaf->valueAt(pos);
+    leaf->readUnlockOrRestart(versionLeaf, needRestart);
+    if (needRestart) return restartAt(TreeOperation::Lookup, height - 1, leaf);
+    return true;
+}
+
+bool OLC_StringBTree::lookup(std::string_view k, Payload& result) {
+    bool found = false;
+    Backoff backoff(backoffPolicy);
+    while (!tryLookup(k, result, found)) {
+        backoff.wait();
+    }
+    return found;
+}
+
+bool OLC_StringBTree::tryRemove(std::string_view k, bool& found) {
+    bool needRestart = false;
+    StringNode* leaf = nullptr;
+    uint64_t versionLeaf = 0;
+    if (!tryFindLeaf(TreeOperation::Remove, k, leaf, versionLeaf)) return false;
+
+    unsigned pos = leaf->lowerBound(k, found);
+    if (!found) {
+        leaf->readUnlockOrRestart(versionLeaf, needRestart);
+        if (needRestart) return restartAt(TreeOperation::Remove, height - 1, leaf);
+        return true;
+    }
+    leaf->upgradeToWriteLockOrRestart(versionLeaf, needRestart);
+    if (needRestart) return restartAt(TreeOperation::Remove, height - 1, leaf);
+    leaf->removeAt(pos);
+    leaf->writeUnlock();
+    return true;
+}
+
+bool OLC_StringBTree::remove(std::string_view k) {
+    bool found = false;
+    Backoff backoff(backoffPolicy);
+    while (!tryRemove(k, found)) {
+        backoff.wait();
+    }
+    return found;
+}
+
+uint64_t OLC_StringBTree::scan(std::string_view start, uint64_t limit, std::vector<std::string>& keysOut,
+                               Payload* payloadsOut) {
+    uint64_t produced = 0;
+    std::string resume(start);
+    bool resumeCopied = false; // continue behind resume, it is the last key we copied
+    uint64_t versionLeaf = 0;
+
+    // Nodes are never merged away, so we only have to wait until the leaf is unlocked.
+    // The wait counts as a single restart.
+    auto readLockLeaf = [&](StringNode* leaf) {
+        bool needRestart = false;
+        versionLeaf = leaf->readLockOrRestart(needRestart);
+        if (!needRestart) return leaf;
+        restartAt(TreeOperation::Scan, height - 1, leaf);
+        Backoff backoff(backoffPolicy);
+        do {
+            backoff.wait();
+            needRestart = false;
+            versionLeaf = leaf->readLockOrRestart(needRestart);
+        } while (needRestart);
+        return leaf;
+    };
+
+    StringNode* leaf = (limit > 0) ? findLeaf(TreeOperation::Scan, resume, versionLeaf) : nullptr;
+    while (leaf) {
+        bool needRestart = false;
+        size_t keysBefore = keysOut.size();
+        bool found = false;
+        unsigned pos = leaf->lowerBound(resume, found);
+        if (resumeCopied && found) ++pos;
+        uint64_t n = 0;
+        for (; pos < leaf->slotCount() && produced + n < limit; ++pos, ++n) {
+            keysOut.emplace_back(leaf->keyAt(pos));
+            if (payloadsOut) payloadsOut[produced + n] = leaf->valueAt(pos);
+        }
+        StringNode* next = leaf->link;
+        leaf->readUnlockOrRestart(versionLeaf, needRestart);
+        if (needRestart) {
+            // The leaf changed while we copied it, only this leaf has to be read again.
+            // Keys that moved to a new right sibling are reached through the next pointer.
+            restartAt(TreeOperation::Scan, height - 1, leaf);
+            keysOut.resize(keysBefore);
+            leaf = readLockLeaf(leaf);
+            continue;
+        }
+
+        produced += n;
+        if (produced == limit || !next) break;
+        if (n > 0) {
+            resume = keysOut.back();
+            resumeCopied = true;
+        }
+        leaf = readLockLeaf(next);
+    }
+    return produced;
+}
@@ -0,0 +1,350 @@
+#include "PrefixNodes.hpp"
+#include "NodeSearch.hpp"
+#include <algorithm>
+#include <cstring>
+
+// -------------------------------------------------------------------------------------
+// PREFIX LEAF
+// -------------------------------------------------------------------------------------
+// A position that is valid for the current width can be outside the arrays of the width
+// an optimistic reader saw, so it is clamped.
+template <class Key, class Payload, class Latch>
+Key PrefixLeaf<Key, Payload, Latch>::keyAt(unsigned pos, unsigned bytes) const {
+    return Coding::withSuffix(bytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        return static_cast<Key>(prefix | suffixes<Suffix>()[std::min(pos, capacityFor(sizeof(Suffix)) - 1)]);
+    });
+}
+
+template <class Key, class Payload, class Latch>
+unsigned PrefixLeaf<Key, Payload, Latch>::lowerBound(Key k, unsigned bytes) {
+    unsigned n = entryCount(bytes);
+    if (Coding::prefixOf(k, bytes) != prefix) return (k < prefix) ? 0 : n;
+    return Coding::withSuffix(bytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        return ::lowerBound(suffixes<Suffix>(), n, static_cast<Suffix>(k));
+    });
+}
+
+template <class Key, class Payload, class Latch>
+bool PrefixLeaf<Key, Payload, Latch>::find(Key k, Payload& p) {
+    unsigned bytes = suffixBytes;
+    unsigned pos = lowerBound(k, bytes);
+    if (pos >= entryCount(bytes) || keyAt(pos, bytes) != k) return false;
+    if constexpr (payloadSize > 0) p = payloads(bytes)[pos];
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+bool PrefixLeaf<Key, Payload, Latch>::contains(Key k) {
+    unsigned bytes = suffixBytes;
+    unsigned pos = lowerBound(k, bytes);
+    return pos < entryCount(bytes) && keyAt(pos, bytes) == k;
+}
+
+template <class Key, class Payload, class Latch>
+bool PrefixLeaf<Key, Payload, Latch>::canInsert(Key k) {
+    unsigned n = entryCount();
+    if (n == 0) return true;
+    Key low = std::min(k, keyAt(0));
+    Key high = std::max(k, keyAt(n - 1));
+    return n < capacityFor(Coding::suffixBytes(low, high));
+}
+
+template <class Key, class Payload, class Latch>
+bool PrefixLeaf<Key, Payload, Latch>::canMerge(PrefixLeaf* right) {
+    unsigned total = count + right->count;
+    if (count == 0 || right->count == 0) return true; // the entries of one leaf fit in any case
+    return total <= capacityFor(Coding::suffixBytes(keyAt(0), right->keyAt(right->count - 1)));
+}
+
+template <class Key, class Payload, class Latch>
+void PrefixLeaf<Key, Payload, Latch>::insert(Key k, Payload p) {
+    unsigned pos = lowerBound(k);
+    if (pos < count && keyAt(pos) == k) {
+        if constexpr (payloadSize > 0) payloads()[pos] = p;
+        return;
+    }
+    if (count == 0 || Coding::prefixOf(k, suffixBytes) != prefix) {
+        // k does not share the prefix, all entries get wider suffixes
+        Key keys[maxCapacity + 1];
+        Payload values[maxCapacity + 1];
+        decode(keys, values);
+        std::memmove(keys + pos + 1, keys + pos, sizeof(Key) * (count - pos));
+        std::memmove(values + pos + 1, values + pos, sizeof(Payload) * (count - pos));
+        keys[pos] = k;
+        values[pos] = p;
+        encode(keys, values, count + 1);
+        return;
+    }
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        Suffix* s = suffixes<Suffix>();
+        std::memmove(s + pos + 1, s + pos, sizeof(Suffix) * (count - pos));
+        s[pos] = static_cast<Suffix>(k);
+    });
+    if constexpr (payloadSize > 0) {
+        Payload* values = payloads();
+        std::memmove(values + pos + 1, values + pos, sizeof(Payload) * (count - pos));
+        values[pos] = p;
+    }
+    ++count;
+}
+
+template <class Key, class Payload, class Latch>
+bool PrefixLeaf<Key, Payload, Latch>::remove(Key k) {
+    unsigned pos = lowerBound(k);
+    if (pos >= count || keyAt(pos) != k) return false;
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        Suffix* s = suffixes<Suffix>();
+        std::memmove(s + pos, s + pos + 1, sizeof(Suffix) * (count - pos - 1));
+    });
+    if constexpr (payloadSize > 0) {
+        Payload* values = payloads();
+        std::memmove(values + pos, values + pos + 1, sizeof(Payload) * (count - pos - 1));
+    }
+    --count;
+    return true;
+}
+
+template <class Key, class Payload, class Latch>
+void PrefixLeaf<Key, Payload, Latch>::decode(Key* keysOut, Payload* payloadsOut) {
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        const Suffix* s = suffixes<Suffix>();
+        for (unsigned i = 0; i < count; ++i) keysOut[i] = static_cast<Key>(prefix | s[i]);
+    });
+    if constexpr (payloadSize > 0) {
+        if (payloadsOut) std::memcpy(payloadsOut, payloads(), sizeof(Payload) * count);
+    }
+}
+
+template <class Key, class Payload, class Latch>
+void PrefixLeaf<Key, Payload, Latch>::encode(const Key* keys, const Payload* payloadsIn, unsigned n) {
+    suffixBytes = (n > 0) ? Coding::suffixBytes(keys[0], keys[n - 1]) : sizeof(Key);
+    prefix = (n > 0) ? Coding::prefixOf(keys[0], suffixBytes) : 0;
+    count = n;
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        Suffix* s = suffixes<Suffix>();
+        for (unsigned i = 0; i < n; ++i) s[i] = static_cast<Suffix>(keys[i]);
+    });
+    if constexpr (payloadSize > 0) {
+        if (payloadsIn) std::memcpy(payloads(), payloadsIn, sizeof(Payload) * n);
+    }
+}
+
+template <class Key, class Payload, class Latch>
+PrefixLeaf<Key, Payload, Latch>* PrefixLeaf<Key, Payload, Latch>::split(Key& sep, NodeArena& arena) {
+    // both halves cover a part of the range of this leaf, so their suffixes are not wider
+    Key keys[maxCapacity];
+    Payload values[maxCapacity];
+    decode(keys, values);
+    unsigned total = count;
+    unsigned leftCount = total / 2;
+    PrefixLeaf* newLeaf = new (arena.allocate()) PrefixLeaf();
+    newLeaf->encode(keys + leftCount, values + leftCount, total - leftCount);
+    encode(keys, values, leftCount);
+    sep = shortestSeparator(keys[leftCount - 1], keys[leftCount]);
+    newLeaf->next = next;
+    next = newLeaf;
+    return newLeaf;
+}
+
+template <class Key, class Payload, class Latch>
+void PrefixLeaf<Key, Payload, Latch>::merge(PrefixLeaf* right) {
+    Key keys[maxCapacity];
+    Payload values[maxCapacity];
+    decode(keys, values);
+    right->decode(keys + count, values + count);
+    encode(keys, values, count + right->count);
+    next = right->next;
+}
+
+template <class Key, class Payload, class Latch>
+Key PrefixLeaf<Key, Payload, Latch>::rebalance(PrefixLeaf* right) {
+    Key keys[2 * maxCapacity];
+    Payload values[2 * maxCapacity];
+    unsigned total = count + right->count;
+    decode(keys, values);
+    right->decode(keys + count, values + count);
+    unsigned leftCount = total / 2;
+    // Without payloads a full narrow leaf holds more than twice the entries of a wide one,
+    // the halves can need wider suffixes than fit.
+    if (leftCount > capacityFor(Coding::suffixBytes(keys[0], keys[leftCount - 1])) ||
+        total - leftCount > capacityFor(Coding::suffixBytes(keys[leftCount], keys[total - 1]))) {
+        return shortestSeparator(keys[count - 1], keys[count]);
+    }
+    right->encode(keys + leftCount, values + leftCount, total - leftCount);
+    encode(keys, values, leftCount);
+    return shortestSeparator(keys[leftCount - 1], keys[leftCount]);
+}
+
+template <class Key, class Payload, class Latch>
+void PrefixLeaf<Key, Payload, Latch>::load(const Key* keys, const Payload* payloadsIn, unsigned n, const Key*, const Key*) {
+    encode(keys, payloadsIn, n);
+}
+
+template <class Key, class Payload, class Latch>
+unsigned PrefixLeaf<Key, Payload, Latch>::copyEntries(Key from, bool exclusive, uint64_t limit, Key* keysOut, Payload* payloadsOut) {
+    unsigned bytes = suffixBytes;
+    unsigned n = entryCount(bytes);
+    unsigned pos = lowerBound(from, bytes);
+    if (exclusive && pos < n && keyAt(pos, bytes) == from) ++pos;
+    if (pos >= n) return 0;
+    unsigned copied = std::min<uint64_t>(n - pos, limit);
+    Coding::withSuffix(bytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        const Suffix* s = suffixes<Suffix>() + pos;
+        for (unsigned i = 0; i < copied; ++i) keysOut[i] = static_cast<Key>(prefix | s[i]);
+    });
+    if constexpr (payloadSize > 0) {
+        if (payloadsOut) std::memcpy(payloadsOut, payloads(bytes) + pos, sizeof(Payload) * copied);
+    }
+    return copied;
+}
+
+// -------------------------------------------------------------------------------------
+// PREFIX INNER
+// -------------------------------------------------------------------------------------
+template <class Key, class Latch>
+Key PrefixInner<Key, Latch>::keyAt(unsigned pos, unsigned bytes) const {
+    return Coding::withSuffix(bytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        return static_cast<Key>(prefix | suffixes<Suffix>()[std::min(pos, capacityFor(sizeof(Suffix)) - 1)]);
+    });
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::setKeyAt(unsigned pos, Key k) {
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        suffixes<Suffix>()[pos] = static_cast<Suffix>(k);
+    });
+}
+
+template <class Key, class Latch>
+unsigned PrefixInner<Key, Latch>::lowerBound(Key k) {
+    // the result is at most entryCount(bytes), the child at it is inside the data array for any width
+    unsigned bytes = suffixBytes;
+    unsigned n = entryCount(bytes);
+    if (Coding::prefixOf(k, bytes) != prefix) return (k < prefix) ? 0 : n;
+    return Coding::withSuffix(bytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        return ::lowerBound(suffixes<Suffix>(), n, static_cast<Suffix>(k));
+    });
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::insert(Key k, NodeBase* child) {
+    unsigned pos = lowerBound(k);
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        Suffix* s = suffixes<Suffix>();
+        std::memmove(s + pos + 1, s + pos, sizeof(Suffix) * (count - pos));
+        s[pos] = static_cast<Suffix>(k);
+    });
+    NodeBase** c = children();
+    std::memmove(c + pos + 1, c + pos, sizeof(NodeBase*) * (count - pos + 1));
+    c[pos] = child;
+    // the split node keeps the lower half, so it has to stay left of the separator
+    std::swap(c[pos], c[pos + 1]);
+    ++count;
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::removeAt(unsigned pos) {
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        Suffix* s = suffixes<Suffix>();
+        std::memmove(s + pos, s + pos + 1, sizeof(Suffix) * (count - pos - 1));
+    });
+    NodeBase** c = children();
+    std::memmove(c + pos + 1, c + pos + 2, sizeof(NodeBase*) * (count - pos - 1));
+    --count;
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::decode(Key* keysOut, NodeBase** childrenOut) {
+    for (unsigned i = 0; i < count; ++i) keysOut[i] = keyAt(i);
+    std::memcpy(childrenOut, children(), sizeof(NodeBase*) * (count + 1));
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::encode(const Key* keys, NodeBase* const* childrenIn, unsigned n, Key low, Key high) {
+    lowest = low;
+    highest = high;
+    suffixBytes = Coding::suffixBytes(low, high);
+    prefix = Coding::prefixOf(low, suffixBytes);
+    count = n;
+    std::memcpy(children(), childrenIn, sizeof(NodeBase*) * (n + 1));
+    Coding::withSuffix(suffixBytes, [&](auto suffix) {
+        using Suffix = decltype(suffix);
+        Suffix* s = suffixes<Suffix>();
+        for (unsigned i = 0; i < n; ++i) s[i] = static_cast<Suffix>(keys[i]);
+    });
+}
+
+template <class Key, class Latch>
+PrefixInner<Key, Latch>* PrefixInner<Key, Latch>::split(Key& sep, NodeArena& arena) {
+    Key keys[maxCapacity];
+    NodeBase* nodes[maxCapacity];
+    decode(keys, nodes);
+    unsigned rightCount = count - (count / 2);
+    unsigned leftCount = count - rightCount - 1;
+    sep = keys[leftCount];
+    PrefixInner* newInner = new (arena.allocate()) PrefixInner();
+    newInner->encode(keys + leftCount + 1, nodes + leftCount + 1, rightCount, sep + 1, highest);
+    encode(keys, nodes, leftCount, lowest, sep);
+    return newInner;
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::merge(Key sep, PrefixInner* right) {
+    Key keys[2 * maxCapacity];
+    NodeBase* nodes[2 * maxCapacity];
+    decode(keys, nodes);
+    keys[count] = sep;
+    right->decode(keys + count + 1, nodes + count + 1);
+    encode(keys, nodes, count + right->count + 1, lowest, right->highest);
+}
+
+template <class Key, class Latch>
+Key PrefixInner<Key, Latch>::rebalance(Key sep, PrefixInner* right) {
+    // Concatenate both nodes with the parent separator in between and cut in the middle.
+    Key keys[2 * maxCapacity];
+    NodeBase* nodes[2 * maxCapacity];
+    decode(keys, nodes);
+    keys[count] = sep;
+    right->decode(keys + count + 1, nodes + count + 1);
+    unsigned total = count + right->count + 1;
+    unsigned leftCount = total / 2;
+    Key newSep = keys[leftCount];
+    right->encode(keys + leftCount + 1, nodes + leftCount + 1, total - leftCount - 1, newSep + 1, right->highest);
+    encode(keys, nodes, leftCount, lowest, newSep);
+    return newSep;
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::load(NodeBase* const* childrenIn, const Key* keys, unsigned n, const Key* lowerFence,
+                                   const Key* upperFence) {
+    encode(keys, childrenIn, n - 1, lowerFence ? *lowerFence + 1 : 0, upperFence ? *upperFence : Coding::maxKey);
+}
+
+template <class Key, class Latch>
+void PrefixInner<Key, Latch>::copyFrom(const PrefixInner& other) {
+    count = other.count;
+    lowest = other.lowest;
+    highest = other.highest;
+    prefix = other.prefix;
+    suffixBytes = other.suffixBytes;
+    std::memcpy(data, other.data, dataSize);
+}
+
+// -------------------------------------------------------------------------------------
+template struct PrefixLeaf<uint64_t, uint64_t, OptLatch>;
+template struct PrefixLeaf<uint64_t, NoPayload, OptLatch>;
+template struct PrefixLeaf<uint32_t, uint32_t, OptLatch>;
+template struct PrefixInner<uint64_t, OptLatch>;
+template struct PrefixInner<uint32_t, OptLatch>;
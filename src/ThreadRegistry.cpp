@@ -0,0 +1,43 @@
+#include "ThreadRegistry.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+std::atomic<bool> usedIds[maxThreads];
+std::atomic<unsigned> highWatermark{0};
+
+struct Registration {
+    unsigned id;
+
+    Registration() {
+        for (unsigned i = 0; i < maxThreads; ++i) {
+            bool expected = false;
+            if (!usedIds[i].load() && usedIds[i].compare_exchange_strong(expected, true)) {
+                id = i;
+                unsigned watermark = highWatermark.load();
+                while (watermark <= i && !highWatermark.compare_exchange_weak(watermark, i + 1)) {
+                }
+                return;
+            }
+        }
+        std::cerr << "more than " << maxThreads << " concurrent threads" << std::endl;
+        std::abort();
+    }
+
+    ~Registration() {
+        usedIds[id].store(false);
+    }
+};
+
+}  // namespace
+
+unsigned threadId() {
+    static thread_local Registration registration;
+    return registration.id;
+}
+
+unsigned threadIdHighWatermark() {
+    return highWatermark.load();
+}
@@ -0,0 +1,817 @@
+#include <atomic>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "catch.hpp"
+#include "EpochManager.hpp"
+#include "FingerprintNodes.hpp"
+#include "GappedNodes.hpp"
+#include "NodeArena.hpp"
+#include "OLC_BTree.hpp"
+#include "OLC_StringBTree.hpp"
+#include "PrefixNodes.hpp"
+
+///// ----------------------- CONCURRENT TEST CASES ----------------------- /////
+
+TEST_CASE("TEST OLC BTREE CONCURRENT UPSERTS", "[ll-concurrent-upserts]")
+{
+   OLC_BTree tree;
+   const uint64_t numThreads = 8;
+   const uint64_t numKeys = 2e6;
+   std::vector<std::thread> threads;
+   for(uint64_t t = 0; t < numThreads; t++){
+      // interleaved keys, so all threads hit the same leaves and split them concurrently
+      threads.emplace_back([&tree, t, numThreads, numKeys]() {
+         for(uint64_t k = t; k < numKeys; k += numThreads){
+            tree.upsert(k, k);
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+
+   for(uint64_t k = 0; k < numKeys; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result));
+      REQUIRE(result == k);
+   }
+   REQUIRE(tree.getHeight() > 2);
+}
+
+TEST_CASE("TEST OLC BTREE CONCURRENT UPSERTS AND LOOKUPS", "[ll-concurrent-upserts-lookups]")
+{
+   OLC_BTree tree;
+   const uint64_t numKeys = 1e6;
+   for(uint64_t k = 0; k < numKeys; k += 2){
+      tree.upsert(k, k);
+   }
+
+   std::atomic<uint64_t> missing{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 0; t < 4; t++){
+      threads.emplace_back([&tree, t, numKeys]() {
+         for(uint64_t k = 1 + 2 * t; k < numKeys; k += 8){
+            tree.upsert(k, k);
+         }
+      });
+   }
+   for(uint64_t t = 0; t < 4; t++){
+      threads.emplace_back([&tree, &missing, numKeys]() {
+         // keys inserted before the writers started must stay visible while they split
+         // (catch assertions are not thread safe, so we only count failures here)
+         for(uint64_t k = 0; k < numKeys; k += 2){
+            uint64_t result = 0;
+            if(!tree.lookup(k,result) || result != k){
+               missing++;
+            }
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(missing == 0);
+
+   for(uint64_t k = 0; k < numKeys; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result));
+      REQUIRE(result == k);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE CONCURRENT SCANS AND UPSERTS", "[ll-concurrent-scans]")
+{
+   OLC_BTree tree;
+   const uint64_t numKeys = 1e6;
+   for(uint64_t k = 0; k < numKeys; k += 2){
+      tree.upsert(k, k);
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, t, numKeys]() {
+         for(uint64_t k = 1 + 2 * t; k < numKeys; k += 4){
+            tree.upsert(k, k);
+         }
+      });
+   }
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, &errors, numKeys]() {
+         std::vector<Key> keys(512);
+         std::vector<Payload> payloads(512);
+         for(uint64_t start = 0; start + 2 * keys.size() < numKeys; start += 1000){
+            uint64_t n = tree.scan(start, keys.size(), keys.data(), payloads.data());
+            // all even keys are present from the beginning, so a scan can never skip one
+            uint64_t expectedEven = start;
+            for(uint64_t i = 0; i < n; i++){
+               if(keys[i] != payloads[i] || keys[i] < start || (i > 0 && keys[i] <= keys[i-1])){
+                  errors++;
+               }
+               if(keys[i] % 2 == 0){
+                  if(keys[i] != expectedEven) errors++;
+                  expectedEven = keys[i] + 2;
+               }
+            }
+            if(n != keys.size()) errors++;
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+}
+
+TEST_CASE("TEST OLC BTREE CONCURRENT SCANS AND REBALANCES", "[ll-concurrent-scans-rebalance]")
+{
+   const uint64_t numKeys = 20000;
+   auto kept = [](uint64_t k) { return k % 64 == 0; };
+   std::vector<Key> keys(numKeys);
+   for(uint64_t k = 0; k < numKeys; k++){
+      keys[k] = k;
+   }
+
+   std::atomic<uint64_t> errors{0};
+   for(uint64_t round = 0; round < 50; round++){
+      // Full leaves, removing the keys of a leaf in ascending order leaves it underfull next
+      // to a full right sibling, so the rebalance moves the first entries of the sibling left.
+      OLC_BTree tree;
+      tree.bulkLoad(keys.data(), keys.data(), numKeys);
+      std::atomic<bool> done{false};
+      std::vector<std::thread> threads;
+      for(uint64_t t = 0; t < 2; t++){
+         threads.emplace_back([&tree, &errors, &kept, t, numKeys]() {
+            for(uint64_t k = t; k < numKeys; k += 2){
+               if(!kept(k) && !tree.remove(k)) errors++;
+            }
+         });
+      }
+      // the kept keys are never removed, so every scan has to return all of them
+      for(uint64_t t = 0; t < 2; t++){
+         threads.emplace_back([&tree, &errors, &done, &kept, numKeys]() {
+            std::vector<Key> scanned(numKeys);
+            std::vector<Payload> payloads(numKeys);
+            while(!done){
+               uint64_t n = tree.scan(0, numKeys, scanned.data(), payloads.data());
+               uint64_t expectedKept = 0;
+               for(uint64_t i = 0; i < n; i++){
+                  if(scanned[i] != payloads[i] || (i > 0 && scanned[i] <= scanned[i-1])) errors++;
+                  if(kept(scanned[i])){
+                     if(scanned[i] != expectedKept) errors++;
+                     expectedKept = scanned[i] + 64;
+                  }
+               }
+               if(expectedKept != (numKeys + 63) / 64 * 64) errors++;
+            }
+         });
+      }
+      threads[0].join();
+      threads[1].join();
+      done = true;
+      threads[2].join();
+      threads[3].join();
+   }
+   REQUIRE(errors == 0);
+}
+
+TEST_CASE("TEST EPOCH MANAGER DEFERS RECLAMATION", "[ll-epochs]")
+{
+   std::atomic<uint64_t> reclaimed{0};
+   auto reclaimer = [](void* context, void* ptr) {
+      static_cast<std::atomic<uint64_t>*>(context)->fetch_add(1);
+      delete static_cast<uint64_t*>(ptr);
+   };
+   {
+      EpochManager epochs(reclaimer, &reclaimed);
+      std::atomic<bool> readerEntered{false};
+      std::atomic<bool> readerDone{false};
+      std::thread reader([&]() {
+         EpochGuard guard(epochs);
+         readerEntered = true;
+         while(!readerDone){
+            std::this_thread::yield();
+         }
+      });
+      while(!readerEntered){
+         std::this_thread::yield();
+      }
+
+      // the reader entered before these were retired, so none of them may be freed
+      for(uint64_t i = 0; i < 1000; i++){
+         EpochGuard guard(epochs);
+         epochs.retire(new uint64_t(i));
+      }
+      REQUIRE(reclaimed == 0);
+
+      readerDone = true;
+      reader.join();
+      for(uint64_t i = 0; i < 1000; i++){
+         EpochGuard guard(epochs);
+         epochs.retire(new uint64_t(i));
+      }
+      REQUIRE(reclaimed > 0);
+   }
+   REQUIRE(reclaimed == 2000);
+}
+
+TEST_CASE("TEST OLC BTREE CONCURRENT UPSERTS AND REMOVES", "[ll-concurrent-removes]")
+{
+   OLC_BTree tree;
+   const uint64_t numKeys = 1e6;
+   // keys divisible by 4 stay in the tree, all other keys are inserted and removed again
+   for(uint64_t k = 0; k < numKeys; k++){
+      tree.upsert(k, k);
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t k = t; k < numKeys; k += 4){
+               if(!tree.remove(k)) errors++;
+            }
+            for(uint64_t k = t; k < numKeys; k += 4){
+               tree.upsert(k, k);
+            }
+         }
+         for(uint64_t k = t; k < numKeys; k += 4){
+            if(!tree.remove(k)) errors++;
+         }
+      });
+   }
+   threads.emplace_back([&tree, &errors, numKeys]() {
+      for(uint64_t k = 0; k < numKeys; k += 4){
+         uint64_t result = 0;
+         if(!tree.lookup(k,result) || result != k) errors++;
+      }
+   });
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   std::vector<Key> keys(numKeys);
+   std::vector<Payload> payloads(numKeys);
+   REQUIRE(tree.scan(0, numKeys, keys.data(), payloads.data()) == numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      REQUIRE(keys[i] == 4*i);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE CONCURRENT REPLICATED UPPER LEVELS", "[ll-concurrent-replicas]")
+{
+   OLC_BTree tree(NodeAllocMode::Default, NumaPolicy::None, 2);
+   const uint64_t numKeys = 1e6;
+   std::vector<Key> keys(numKeys / 4);
+   std::vector<Payload> payloads(numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      keys[i] = 4*i;
+      payloads[i] = 4*i;
+   }
+   tree.bulkLoad(keys.data(), payloads.data(), keys.size(), 0.1);
+
+   // the writers keep changing the replicated levels while the readers descend the replicas
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t k = t; k < numKeys; k += 4){
+               tree.upsert(k, k);
+            }
+            for(uint64_t k = t; k < numKeys; k += 4){
+               if(!tree.remove(k)) errors++;
+            }
+         }
+      });
+   }
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, &errors, numKeys]() {
+         for(uint64_t k = 0; k < numKeys; k += 4){
+            uint64_t result = 0;
+            if(!tree.lookup(k,result) || result != k) errors++;
+         }
+         Key scanned[16];
+         Payload scannedPayloads[16];
+         for(uint64_t k = 0; k < numKeys; k += 1024){
+            uint64_t n = tree.scan(k, 16, scanned, scannedPayloads);
+            for(uint64_t i = 0; i < n; i++){
+               if(scanned[i] < k || scannedPayloads[i] != scanned[i]) errors++;
+            }
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   std::vector<Key> scanned(numKeys);
+   std::vector<Payload> scannedPayloads(numKeys);
+   REQUIRE(tree.scan(0, numKeys, scanned.data(), scannedPayloads.data()) == numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      REQUIRE(scanned[i] == 4*i);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE CONTENTION STATS", "[ll-contention-stats]")
+{
+   OLC_BTree tree;
+   const uint64_t numThreads = 4;
+   const uint64_t numKeys = 1e6;
+   std::vector<std::thread> threads;
+   for(uint64_t t = 0; t < numThreads; t++){
+      threads.emplace_back([&tree, t, numThreads, numKeys]() {
+         for(uint64_t k = t; k < numKeys; k += numThreads){
+            tree.upsert(k, k);
+            uint64_t result = 0;
+            tree.lookup(k - t, result);
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+
+   // every restart is counted once by cause and once by level
+   ContentionStats stats = tree.stats();
+   for(unsigned op = 0; op < ContentionStats::operations; op++){
+      uint64_t byLevel = 0;
+      for(unsigned level = 0; level < ContentionStats::maxLevels; level++){
+         byLevel += stats.restartsByLevel[op][level];
+      }
+      REQUIRE(byLevel == stats.total(static_cast<TreeOperation>(op)));
+   }
+   REQUIRE(stats.total(TreeOperation::Remove) == 0);
+   REQUIRE(stats.total(TreeOperation::Scan) == 0);
+
+   tree.resetStats();
+   for(uint64_t k = 0; k < numKeys; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result));
+   }
+   REQUIRE(tree.stats().total() == 0);
+
+   // a lookup that finds the root write latched restarts there until it is released
+   tree.setSharedFallback(0);
+   bool needRestart = false;
+   tree.getRoot()->writeLockOrRestart(needRestart);
+   REQUIRE(!needRestart);
+   uint64_t result = 0;
+   bool found = false;
+   std::thread reader([&tree, &result, &found]() { found = tree.lookup(42, result); });
+   while(tree.stats().total(TreeOperation::Lookup) == 0){
+      std::this_thread::yield();
+   }
+   tree.getRoot()->writeUnlock();
+   reader.join();
+   REQUIRE(found);
+   REQUIRE(result == 42);
+   stats = tree.stats();
+   REQUIRE(stats.total(TreeOperation::Lookup) > 0);
+   REQUIRE(stats.total() == stats.total(TreeOperation::Lookup));
+   REQUIRE(stats.total(RestartCause::Locked) == stats.total());
+   REQUIRE(stats.restartsByLevel[static_cast<unsigned>(TreeOperation::Lookup)][0] == stats.total());
+}
+
+TEST_CASE("TEST OLC BTREE BACKOFF POLICIES", "[ll-backoff]")
+{
+   const uint64_t numThreads = 4;
+   const uint64_t numKeys = 4e5;
+   for(BackoffPolicy::Kind kind : {BackoffPolicy::Kind::Spin, BackoffPolicy::Kind::Pause, BackoffPolicy::Kind::Exponential}){
+      for(unsigned yieldAfter : {0u, 4u}){
+         OLC_BTree tree;
+         tree.setBackoffPolicy({kind, 64, yieldAfter});
+         std::vector<std::thread> threads;
+         for(uint64_t t = 0; t < numThreads; t++){
+            // all threads update the same few hot keys in between
+            threads.emplace_back([&tree, t, numThreads, numKeys]() {
+               for(uint64_t k = t; k < numKeys; k += numThreads){
+                  tree.upsert(k, k);
+                  tree.upsert(numKeys + k % 8, k);
+               }
+            });
+         }
+         for(auto& thread : threads){
+            thread.join();
+         }
+         uint64_t errors = 0;
+         for(uint64_t k = 0; k < numKeys + 8; k++){
+            uint64_t result = 0;
+            if(!tree.lookup(k,result) || (k < numKeys && result != k)) errors++;
+         }
+         REQUIRE(errors == 0);
+      }
+   }
+}
+
+TEST_CASE("TEST OLC BTREE SHARED LOOKUP FALLBACK", "[ll-shared-fallback]")
+{
+   OLC_BTree tree;
+   // every restarted lookup continues with shared latches
+   tree.setSharedFallback(1);
+   const uint64_t numKeys = 1e6;
+   for(uint64_t k = 0; k < numKeys; k += 2){
+      tree.upsert(k, k);
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, t, numKeys]() {
+         for(uint64_t k = 1 + 2*t; k < numKeys; k += 4){
+            tree.upsert(k, k);
+            tree.upsert(k % 64, k % 64);
+         }
+         for(uint64_t k = 1 + 2*t; k < numKeys; k += 4){
+            tree.remove(k);
+         }
+      });
+   }
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, &errors, numKeys]() {
+         for(uint64_t round = 0; round < 3; round++){
+            for(uint64_t k = 0; k < numKeys; k += 2){
+               uint64_t result = 0;
+               if(!tree.lookup(k,result) || result != k) errors++;
+            }
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+   ContentionStats stats = tree.stats();
+   REQUIRE(stats.sharedFallbacks[static_cast<unsigned>(TreeOperation::Lookup)] <= stats.total(TreeOperation::Lookup));
+}
+
+TEST_CASE("TEST OLC BTREE CONCURRENT RW LATCHES", "[ll-concurrent-rw-latch]")
+{
+   OLC_BTree<Key, Payload, RWLatch> tree;
+   const uint64_t numKeys = 1e6;
+   for(uint64_t k = 0; k < numKeys; k += 4){
+      tree.upsert(k, k);
+   }
+
+   // writers restart instead of waiting for readers, so they have to make progress anyway
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t k = t; k < numKeys; k += 4){
+               tree.upsert(k, k);
+            }
+            for(uint64_t k = t; k < numKeys; k += 4){
+               if(!tree.remove(k)) errors++;
+            }
+         }
+      });
+   }
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, &errors, numKeys]() {
+         for(uint64_t k = 0; k < numKeys; k += 4){
+            uint64_t result = 0;
+            if(!tree.lookup(k,result) || result != k) errors++;
+         }
+         Key scanned[16];
+         Payload scannedPayloads[16];
+         for(uint64_t k = 0; k < numKeys; k += 1024){
+            uint64_t n = tree.scan(k, 16, scanned, scannedPayloads);
+            for(uint64_t i = 0; i < n; i++){
+               if(scanned[i] < k || scannedPayloads[i] != scanned[i]) errors++;
+            }
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   std::vector<Key> scanned(numKeys);
+   std::vector<Payload> scannedPayloads(numKeys);
+   REQUIRE(tree.scan(0, numKeys, scanned.data(), scannedPayloads.data()) == numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      REQUIRE(scanned[i] == 4*i);
+   }
+}
+
+TEST_CASE("TEST OLC STRING BTREE CONCURRENT UPSERTS AND LOOKUPS", "[ll-concurrent-string-keys]")
+{
+   OLC_StringBTree tree;
+   const uint64_t numKeys = 400000;
+   auto key = [](uint64_t k) { return "tenant/" + std::to_string(k % 13) + "/" + std::to_string(k); };
+   for(uint64_t k = 0; k < numKeys; k += 4){
+      tree.upsert(key(k), k);
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, &key, t, numKeys]() {
+         for(uint64_t k = t; k < numKeys; k += 4){
+            tree.upsert(key(k), k);
+         }
+         for(uint64_t k = t; k < numKeys; k += 8){
+            if(!tree.remove(key(k))) errors++;
+         }
+      });
+   }
+   for(uint64_t t = 0; t < 2; t++){
+      threads.emplace_back([&tree, &errors, &key, numKeys]() {
+         for(uint64_t k = 0; k < numKeys; k += 4){
+            uint64_t result = 0;
+            if(!tree.lookup(key(k),result) || result != k) errors++;
+         }
+         std::vector<std::string> scanned;
+         for(uint64_t k = 0; k < numKeys; k += 4096){
+            scanned.clear();
+            tree.scan(key(k), 16, scanned, nullptr);
+            for(uint64_t i = 1; i < scanned.size(); i++){
+               if(scanned[i - 1] >= scanned[i]) errors++;
+            }
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   for(uint64_t k = 0; k < numKeys; k++){
+      uint64_t result = 0;
+      bool expected = (k % 4 == 0) || (k % 8 >= 4);
+      REQUIRE(tree.lookup(key(k),result) == expected);
+      if(expected) REQUIRE(result == k);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE PREFIX NODES CONCURRENT UPSERTS AND REMOVES", "[ll-concurrent-prefix-nodes]")
+{
+   OLC_BTree<Key, Payload, OptLatch, PrefixNodes> tree(NodeAllocMode::Default, NumaPolicy::None, 1);
+   const uint64_t numKeys = 1e6;
+   // the tenant changes every 2^16 keys, so nodes of every suffix width are split and merged
+   auto tenantKey = [](uint64_t k) { return ((k >> 16) << 40) | (k & 0xffff); };
+   for(uint64_t k = 0; k < numKeys; k += 4){
+      tree.upsert(tenantKey(k), k);
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, &tenantKey, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t k = t; k < numKeys; k += 4){
+               tree.upsert(tenantKey(k), k);
+            }
+            for(uint64_t k = t; k < numKeys; k += 4){
+               if(!tree.remove(tenantKey(k))) errors++;
+            }
+         }
+      });
+   }
+   threads.emplace_back([&tree, &errors, &tenantKey, numKeys]() {
+      for(uint64_t k = 0; k < numKeys; k += 4){
+         uint64_t result = 0;
+         if(!tree.lookup(tenantKey(k), result) || result != k) errors++;
+      }
+   });
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   std::vector<Key> scanned(numKeys);
+   std::vector<Payload> scannedPayloads(numKeys);
+   REQUIRE(tree.scan(0, numKeys, scanned.data(), scannedPayloads.data()) == numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      REQUIRE(scanned[i] == tenantKey(4*i));
+      REQUIRE(scannedPayloads[i] == 4*i);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE COMPACT NODE IDS CONCURRENT UPSERTS AND REMOVES", "[ll-concurrent-node-ids]")
+{
+   OLC_BTree<Key, Payload, OptLatch, CompactNodes> tree(NodeAllocMode::Default, NumaPolicy::None, 1);
+   const uint64_t numKeys = 1e6;
+   for(uint64_t k = 0; k < numKeys; k += 4){
+      tree.upsert(k, k);
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t k = t; k < numKeys; k += 4){
+               tree.upsert(k, k);
+            }
+            for(uint64_t k = t; k < numKeys; k += 4){
+               if(!tree.remove(k)) errors++;
+            }
+         }
+      });
+   }
+   threads.emplace_back([&tree, &errors, numKeys]() {
+      for(uint64_t k = 0; k < numKeys; k += 4){
+         uint64_t result = 0;
+         if(!tree.lookup(k, result) || result != k) errors++;
+      }
+   });
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   std::vector<Key> scanned(numKeys);
+   REQUIRE(tree.scan(0, numKeys, scanned.data(), nullptr) == numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      REQUIRE(scanned[i] == 4*i);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE FINGERPRINT LEAVES CONCURRENT UPSERTS AND SCANS", "[ll-concurrent-fingerprint-leaves]")
+{
+   OLC_BTree<Key, Payload, OptLatch, FingerprintNodes> tree;
+   const uint64_t numKeys = 1e6;
+   // a multiplicative permutation, so all leaves get unsorted entries
+   auto shuffled = [numKeys](uint64_t i) { return (i * 7919) % numKeys; };
+   for(uint64_t i = 0; i < numKeys; i++){
+      if(shuffled(i) % 4 == 0) tree.upsert(shuffled(i), shuffled(i));
+   }
+
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, &shuffled, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t i = 0; i < numKeys; i++){
+               if(shuffled(i) % 4 == t) tree.upsert(shuffled(i), shuffled(i));
+            }
+            for(uint64_t i = 0; i < numKeys; i++){
+               if(shuffled(i) % 4 == t && !tree.remove(shuffled(i))) errors++;
+            }
+         }
+      });
+   }
+   // the keys that are never removed show up in every scan, all keys in ascending order
+   threads.emplace_back([&tree, &errors, numKeys]() {
+      std::vector<Key> scanned(numKeys);
+      std::vector<Payload> payloads(numKeys);
+      for(uint64_t round = 0; round < 5; round++){
+         uint64_t copied = tree.scan(0, numKeys, scanned.data(), payloads.data());
+         uint64_t expected = 0;
+         for(uint64_t i = 0; i < copied; i++){
+            if(payloads[i] != scanned[i] || (i > 0 && scanned[i] <= scanned[i - 1])) errors++;
+            if(scanned[i] % 4 == 0 && scanned[i] != 4*expected++) errors++;
+         }
+         if(expected != numKeys / 4) errors++;
+      }
+   });
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   for(uint64_t k = 0; k < numKeys; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k, result) == (k % 4 == 0));
+   }
+}
+
+TEST_CASE("TEST OLC BTREE GAPPED LEAVES CONCURRENT UPSERTS AND REMOVES", "[ll-concurrent-gapped-leaves]")
+{
+   OLC_BTree<Key, Payload, OptLatch, GappedNodes> tree;
+   const uint64_t numKeys = 1e6;
+   auto shuffled = [numKeys](uint64_t i) { return (i * 7919) % numKeys; };
+   for(uint64_t i = 0; i < numKeys; i++){
+      if(shuffled(i) % 4 == 0) tree.upsert(shuffled(i), shuffled(i));
+   }
+
+   // lookups race with the shifts of inserts into the same leaves
+   std::atomic<uint64_t> errors{0};
+   std::vector<std::thread> threads;
+   for(uint64_t t = 1; t < 4; t++){
+      threads.emplace_back([&tree, &errors, &shuffled, t, numKeys]() {
+         for(uint64_t round = 0; round < 2; round++){
+            for(uint64_t i = 0; i < numKeys; i++){
+               if(shuffled(i) % 4 == t) tree.upsert(shuffled(i), shuffled(i));
+            }
+            for(uint64_t i = 0; i < numKeys; i++){
+               if(shuffled(i) % 4 == t && !tree.remove(shuffled(i))) errors++;
+            }
+         }
+      });
+   }
+   threads.emplace_back([&tree, &errors, numKeys]() {
+      for(uint64_t round = 0; round < 3; round++){
+         for(uint64_t k = 0; k < numKeys; k += 4){
+            uint64_t result = 0;
+            if(!tree.lookup(k, result) || result != k) errors++;
+         }
+      }
+   });
+   for(auto& thread : threads){
+      thread.join();
+   }
+   REQUIRE(errors == 0);
+
+   std::vector<Key> scanned(numKeys);
+   REQUIRE(tree.scan(0, numKeys, scanned.data(), nullptr) == numKeys / 4);
+   for(uint64_t i = 0; i < numKeys / 4; i++){
+      REQUIRE(scanned[i] == 4*i);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE PARALLEL BULK LOAD", "[ll-parallel-bulk-load]")
+{
+   const uint64_t n = 2e6;
+   std::vector<Key> keys(n);
+   std::vector<Payload> payloads(n);
+   for(uint64_t i = 0; i < n; i++){
+      keys[i] = 5*i + 1;
+      payloads[i] = i;
+   }
+   for(unsigned numThreads : {2u, 7u, 64u}){
+      OLC_BTree tree;
+      tree.bulkLoadParallel(keys.data(), payloads.data(), n, 0.9, numThreads);
+      REQUIRE(tree.getHeight() == 3);
+
+      uint64_t errors = 0;
+      for(uint64_t i = 0; i < n; i++){
+         uint64_t result = 0;
+         if(!tree.lookup(5*i + 1,result) || result != i) errors++;
+      }
+      REQUIRE(errors == 0);
+
+      // the leaf chains of the workers have to be stitched together
+      std::vector<Key> scanned(n);
+      std::vector<Payload> scannedPayloads(n);
+      REQUIRE(tree.scan(0, n, scanned.data(), scannedPayloads.data()) == n);
+      REQUIRE(scanned == keys);
+   }
+}
+
+TEST_CASE("TEST NODE ARENA", "[ll-node-arena]")
+{
+   NodeArena arena;
+   const uint64_t numThreads = 4;
+   const uint64_t perThread = 5000;
+   std::vector<std::vector<void*>> allocated(numThreads);
+   std::vector<std::thread> threads;
+   for(uint64_t t = 0; t < numThreads; t++){
+      threads.emplace_back([&arena, &allocated, t, perThread]() {
+         for(uint64_t i = 0; i < perThread; i++){
+            void* node = arena.allocate();
+            // write the whole node, overlapping nodes corrupt each other's marker
+            std::memset(node, static_cast<int>(t), NodeArena::nodeSize);
+            allocated[t].push_back(node);
+         }
+         // free half of them, they have to be handed out again
+         for(uint64_t i = 0; i < perThread / 2; i++){
+            arena.free(allocated[t].back());
+            allocated[t].pop_back();
+         }
+         for(uint64_t i = 0; i < perThread / 2; i++){
+            void* node = arena.allocate();
+            std::memset(node, static_cast<int>(t), NodeArena::nodeSize);
+            allocated[t].push_back(node);
+         }
+      });
+   }
+   for(auto& thread : threads){
+      thread.join();
+   }
+
+   std::set<void*> unique;
+   for(uint64_t t = 0; t < numThreads; t++){
+      for(void* node : allocated[t]){
+         REQUIRE(reinterpret_cast<uintptr_t>(node) % NodeArena::nodeSize == 0);
+         REQUIRE(static_cast<char*>(node)[0] == static_cast<char>(t));
+         REQUIRE(static_cast<char*>(node)[NodeArena::nodeSize - 1] == static_cast<char>(t));
+         unique.insert(node);
+      }
+   }
+   REQUIRE(unique.size() == numThreads * perThread);
+
+   // ids are unique over all arenas and lead back to the node
+   NodeArena other(NodeAllocMode::HugePages);
+   for(uint64_t i = 0; i < perThread; i++){
+      unique.insert(other.allocate());
+   }
+   std::set<uint32_t> ids;
+   for(void* node : unique){
+      uint32_t id = NodeArena::idOf(node);
+      REQUIRE(id != 0);
+      REQUIRE(NodeArena::nodeOf(id) == node);
+      ids.insert(id);
+   }
+   REQUIRE(ids.size() == unique.size());
+}
@@ -1,6 +1,19 @@
 #include <thread>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include "catch.hpp"  
 #include "OLC_BTree.hpp"
+#include "OLC_BTreeSet.hpp"
+#include "OLC_StringBTree.hpp"
+#include "NodeSearch.hpp"
+#include "PrefixNodes.hpp"
+#include "FingerprintNodes.hpp"
+#include "GappedNodes.hpp"
 
 #include <iostream>
 ///// ----------------------- BASIC TEST CASES ----------------------- ///// 
@@ -57,3 +70,986 @@ TEST_CASE("TEST OLC BTREE UPSERT AND LOOKUPS AND UPDATE", "[ll-upsert-lookups]")
       REQUIRE(result == (k+1));
    }
 }
+
+
+
+TEST_CASE("TEST OLC BTREE SCAN", "[ll-scan]")
+{
+   OLC_BTree tree;
+   for(uint64_t k = 0; k < 1e6; k++){
+      tree.upsert(2*k,k);
+   }
+
+   std::vector<Key> keys(1000);
+   std::vector<Payload> payloads(1000);
+   for(uint64_t start = 0; start < 2e6; start += 9973){
+      uint64_t n = tree.scan(start, keys.size(), keys.data(), payloads.data());
+      uint64_t first = (start + 1) / 2;
+      REQUIRE(n == std::min<uint64_t>(1000, 1e6 - first));
+      for(uint64_t i = 0; i < n; i++){
+         REQUIRE(keys[i] == 2*(first+i));
+         REQUIRE(payloads[i] == first+i);
+      }
+   }
+   REQUIRE(tree.scan(2e6, keys.size(), keys.data(), payloads.data()) == 0);
+}
+
+
+
+TEST_CASE("TEST NODE SEARCH KERNELS", "[ll-node-search]")
+{
+   std::vector<uint64_t> keys;
+   for(uint64_t i = 0; i < BTreeLeaf<>::maxEntries; i++){
+      // large keys make sure the kernels compare unsigned
+      keys.push_back(i < BTreeLeaf<>::maxEntries / 2 ? 3*i : UINT64_MAX - 3*(BTreeLeaf<>::maxEntries - i));
+   }
+   __builtin_cpu_init();
+   for(unsigned count = 0; count <= keys.size(); count++){
+      for(unsigned i = 0; i < count; i++){
+         for(int64_t delta = -1; delta <= 1; delta++){
+            uint64_t probe = keys[i] + delta;
+            unsigned expected = lowerBoundScalar(keys.data(), count, probe);
+            REQUIRE(lowerBound(keys.data(), count, probe) == expected);
+            if(__builtin_cpu_supports("sse4.2")) REQUIRE(lowerBoundSSE(keys.data(), count, probe) == expected);
+            if(__builtin_cpu_supports("avx2")) REQUIRE(lowerBoundAVX2(keys.data(), count, probe) == expected);
+            if(__builtin_cpu_supports("avx512f")) REQUIRE(lowerBoundAVX512(keys.data(), count, probe) == expected);
+         }
+      }
+   }
+   // the kernels for the suffixes of prefix compressed nodes
+   std::vector<uint32_t> keys32;
+   std::vector<uint16_t> keys16;
+   for(uint32_t i = 0; i < 1000; i++){
+      keys32.push_back(i < 500 ? 3*i : UINT32_MAX - 3*(1000 - i));
+      keys16.push_back(i < 500 ? 3*i : UINT16_MAX - 3*(1000 - i));
+   }
+   for(unsigned count = 0; count <= keys32.size(); count += 7){
+      for(unsigned i = 0; i < count; i++){
+         for(int delta = -1; delta <= 1; delta++){
+            uint32_t probe32 = keys32[i] + delta;
+            uint16_t probe16 = keys16[i] + delta;
+            REQUIRE(lowerBound(keys32.data(), count, probe32) == std::lower_bound(keys32.begin(), keys32.begin() + count, probe32) - keys32.begin());
+            REQUIRE(lowerBound(keys16.data(), count, probe16) == std::lower_bound(keys16.begin(), keys16.begin() + count, probe16) - keys16.begin());
+         }
+      }
+   }
+   // the fingerprint search of unsorted leaves
+   std::vector<uint8_t> bytes(256);
+   for(unsigned i = 0; i < bytes.size(); i++){
+      bytes[i] = (i * 37) % 11;
+   }
+   for(unsigned count = 0; count <= bytes.size(); count += 5){
+      for(unsigned from = 0; from <= count; from++){
+         for(uint8_t byte = 0; byte < 12; byte++){
+            unsigned expected = std::find(bytes.begin() + from, bytes.begin() + count, byte) - bytes.begin();
+            REQUIRE(findByte(bytes.data(), from, count, byte) == expected);
+         }
+      }
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE REMOVE", "[ll-remove]")
+{
+   OLC_BTree tree;
+   for(uint64_t k = 0; k < 1e6; k++){
+      tree.upsert(k,k);
+   }
+   uint64_t fullHeight = tree.getHeight();
+
+   for(uint64_t k = 0; k < 1e6; k += 2){
+      REQUIRE(tree.remove(k));
+   }
+   REQUIRE_FALSE(tree.remove(0));
+   for(uint64_t k = 0; k < 1e6; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result) == (k % 2 == 1));
+   }
+
+   for(uint64_t k = 1; k < 1e6; k += 2){
+      REQUIRE(tree.remove(k));
+   }
+   uint64_t result = 0;
+   REQUIRE_FALSE(tree.lookup(1,result));
+   REQUIRE(tree.getHeight() < fullHeight);
+
+   // the emptied tree has to stay usable
+   for(uint64_t k = 0; k < 1e5; k++){
+      tree.upsert(k,k+1);
+   }
+   for(uint64_t k = 0; k < 1e5; k++){
+      REQUIRE(tree.lookup(k,result));
+      REQUIRE(result == k+1);
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE BULK LOAD", "[ll-bulk-load]")
+{
+   for(double fillFactor : {1.0, 0.7}){
+      OLC_BTree tree;
+      const uint64_t n = 1e6;
+      std::vector<Key> keys(n);
+      std::vector<Payload> payloads(n);
+      for(uint64_t i = 0; i < n; i++){
+         keys[i] = 3*i;
+         payloads[i] = i;
+      }
+      tree.bulkLoad(keys.data(), payloads.data(), n, fillFactor);
+      REQUIRE(tree.getHeight() == 3);
+
+      for(uint64_t i = 0; i < n; i++){
+         uint64_t result = 0;
+         REQUIRE(tree.lookup(3*i,result));
+         REQUIRE(result == i);
+         REQUIRE_FALSE(tree.lookup(3*i+1,result));
+      }
+      std::vector<Key> scanned(n);
+      std::vector<Payload> scannedPayloads(n);
+      REQUIRE(tree.scan(0, n, scanned.data(), scannedPayloads.data()) == n);
+      REQUIRE(scanned == keys);
+
+      // the loaded tree accepts regular updates
+      for(uint64_t i = 0; i < n; i++){
+         tree.upsert(3*i+1, i);
+      }
+      for(uint64_t i = 0; i < n; i += 2){
+         REQUIRE(tree.remove(3*i));
+      }
+      for(uint64_t i = 0; i < n; i++){
+         uint64_t result = 0;
+         REQUIRE(tree.lookup(3*i+1,result));
+         REQUIRE(tree.lookup(3*i,result) == (i % 2 == 1));
+      }
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE LOOKUP BATCH", "[ll-lookup-batch]")
+{
+   OLC_BTree tree;
+   for(uint64_t k = 0; k < 1e6; k++){
+      tree.upsert(2*k,k);
+   }
+
+   // odd sizes make sure the last group is only partially filled
+   const uint64_t n = 100003;
+   std::vector<Key> keys(n);
+   std::vector<Payload> out(n);
+   std::unique_ptr<bool[]> found(new bool[n]);
+   for(uint64_t i = 0; i < n; i++){
+      keys[i] = (i * 7919) % 2000003;
+   }
+   tree.lookupBatch(keys.data(), out.data(), found.get(), n);
+   for(uint64_t i = 0; i < n; i++){
+      bool expected = keys[i] % 2 == 0 && keys[i] < 2e6;
+      REQUIRE(found[i] == expected);
+      if(expected) REQUIRE(out[i] == keys[i] / 2);
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE COROUTINE UPSERTS AND LOOKUPS", "[ll-coroutines]")
+{
+   OLC_BTree tree;
+   const uint64_t n = 200000;
+   {
+      CoroScheduler scheduler(8);
+      for(uint64_t k = 0; k < n; k++){
+         scheduler.spawn(tree.upsertAsync(k, k+1));
+      }
+      scheduler.run();
+   }
+
+   std::vector<Payload> results(n);
+   std::unique_ptr<bool[]> found(new bool[n + 1]);
+   CoroScheduler scheduler(16);
+   for(uint64_t k = 0; k <= n; k++){
+      scheduler.spawn(tree.lookupAsync(k, results[k % n], found[k]));
+   }
+   scheduler.run();
+   for(uint64_t k = 0; k < n; k++){
+      REQUIRE(found[k]);
+      REQUIRE(results[k] == k+1);
+   }
+   REQUIRE_FALSE(found[n]);
+}
+
+
+
+TEST_CASE("TEST OLC BTREE HUGE PAGES", "[ll-huge-pages]")
+{
+   OLC_BTree tree(NodeAllocMode::HugePages);
+   for(uint64_t k = 0; k < 1e6; k++){
+      tree.upsert(k,k);
+   }
+   for(uint64_t k = 0; k < 1e6; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result));
+      REQUIRE(result == k);
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE NUMA POLICIES", "[ll-numa]")
+{
+   for(NumaPolicy policy : {NumaPolicy::InterleaveInner, NumaPolicy::LocalLeaves, NumaPolicy::InterleaveInnerLocalLeaves}){
+      OLC_BTree tree(NodeAllocMode::Default, policy);
+      for(uint64_t k = 0; k < 1e6; k++){
+         tree.upsert(k,k);
+      }
+      for(uint64_t k = 0; k < 1e6; k += 3){
+         REQUIRE(tree.remove(k));
+      }
+      for(uint64_t k = 0; k < 1e6; k++){
+         uint64_t result = 0;
+         REQUIRE(tree.lookup(k,result) == (k % 3 != 0));
+      }
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE REPLICATED UPPER LEVELS", "[ll-replicas]")
+{
+   // sparse nodes, so the tree is tall enough for two replicated levels
+   const uint64_t n = 5e5;
+   std::vector<Key> keys(n);
+   std::vector<Payload> payloads(n);
+   for(uint64_t i = 0; i < n; i++){
+      keys[i] = 2*i + 1;
+      payloads[i] = 2*i + 1;
+   }
+   OLC_BTree tree(NodeAllocMode::Default, NumaPolicy::None, 2);
+   tree.bulkLoad(keys.data(), payloads.data(), n, 0.1);
+   REQUIRE(tree.getHeight() > 4);
+
+   // splits and merges of the replicated levels
+   for(uint64_t k = 0; k < 2*n; k += 2){
+      tree.upsert(k,k);
+   }
+   for(uint64_t k = 0; k < 2*n; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result));
+      REQUIRE(result == k);
+   }
+   for(uint64_t k = 0; k < 2*n; k++){
+      if(k % 64 != 0) REQUIRE(tree.remove(k));
+   }
+   for(uint64_t k = 0; k < 2*n; k++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k,result) == (k % 64 == 0));
+   }
+   std::vector<Key> scanned(n);
+   std::vector<Payload> scannedPayloads(n);
+   REQUIRE(tree.scan(1, n, scanned.data(), scannedPayloads.data()) == 2*n/64 - 1);
+   REQUIRE(scanned[0] == 64);
+}
+
+
+
+TEST_CASE("TEST OPT LATCH SHARED MODE", "[ll-shared-latch]")
+{
+   OptLatch latch;
+   bool needRestart = false;
+   uint64_t version = latch.readLockOrRestart(needRestart);
+   REQUIRE(latch.tryLockShared());
+   REQUIRE(latch.tryLockShared());
+   // shared holders do not disturb optimistic readers
+   latch.readUnlockOrRestart(version, needRestart);
+   REQUIRE(!needRestart);
+
+   latch.upgradeToWriteLockNoWaitOrRestart(version, needRestart);
+   REQUIRE(needRestart);
+   latch.unlockShared();
+   latch.unlockShared();
+
+   needRestart = false;
+   latch.writeLockOrRestart(needRestart);
+   REQUIRE(!needRestart);
+   REQUIRE(!latch.tryLockShared());
+   latch.writeUnlock();
+   REQUIRE(latch.tryLockShared());
+   latch.unlockShared();
+   REQUIRE(latch.sharedCount == 0);
+}
+
+
+
+TEMPLATE_TEST_CASE("TEST OLC BTREE LATCH POLICIES", "[ll-latch-policies]", OptLatch, RWLatch, NoLatch)
+{
+   OLC_BTree<Key, Payload, TestType> tree;
+   const uint64_t n = 100000;
+   for(uint64_t k = 0; k < n; k++){
+      tree.upsert(2*k, k);
+   }
+   for(uint64_t k = 0; k < n; k++){
+      if(k % 2 == 0) REQUIRE(tree.remove(2*k));
+   }
+   for(uint64_t k = 0; k < 2*n; k++){
+      uint64_t result = 0;
+      bool expected = (k % 4 == 2);
+      REQUIRE(tree.lookup(k,result) == expected);
+      if(expected) REQUIRE(result == k / 2);
+   }
+
+   std::vector<Key> keys(n);
+   std::vector<Payload> payloads(n);
+   REQUIRE(tree.scan(0, n, keys.data(), payloads.data()) == n / 2);
+   for(uint64_t i = 0; i < n / 2; i++){
+      REQUIRE(keys[i] == 4*i + 2);
+   }
+
+   std::vector<Payload> out(n);
+   std::unique_ptr<bool[]> found(new bool[n]);
+   tree.lookupBatch(keys.data(), out.data(), found.get(), n / 2);
+   for(uint64_t i = 0; i < n / 2; i++){
+      REQUIRE(found[i]);
+      REQUIRE(out[i] == payloads[i]);
+   }
+
+   CoroScheduler scheduler(8);
+   for(uint64_t i = 0; i < n / 2; i++){
+      scheduler.spawn(tree.upsertAsync(keys[i], 0));
+   }
+   scheduler.run();
+   uint64_t result = 1;
+   REQUIRE(tree.lookup(keys[0], result));
+   REQUIRE(result == 0);
+}
+
+
+
+TEST_CASE("TEST RW LATCH", "[ll-rw-latch]")
+{
+   RWLatch latch;
+   bool needRestart = false;
+   uint64_t version = latch.readLockOrRestart(needRestart);
+   REQUIRE(!needRestart);
+   // a second reader blocks the upgrade instead of waiting for it
+   uint64_t other = latch.readLockOrRestart(needRestart);
+   latch.upgradeToWriteLockOrRestart(version, needRestart);
+   REQUIRE(needRestart);
+   latch.readUnlockOrRestart(other, needRestart);
+
+   needRestart = false;
+   latch.upgradeToWriteLockOrRestart(version, needRestart);
+   REQUIRE(!needRestart);
+   REQUIRE(latch.isLocked(latch.currentVersion()));
+   REQUIRE(!latch.tryLockShared());
+   latch.writeUnlock();
+
+   // shared latches dropped without an unlock are released after the attempt
+   latch.readLockOrRestart(needRestart);
+   latch.readLockOrRestart(needRestart);
+   RWLatch::releaseReadLatches();
+   REQUIRE(latch.currentVersion() == 0);
+
+   latch.writeLockOrRestart(needRestart);
+   latch.writeUnlockObsolete();
+   latch.readLockOrRestart(needRestart);
+   REQUIRE(needRestart);
+}
+
+
+
+// Keys of every key type that are ordered like i.
+template <class K>
+static K testKey(uint64_t i)
+{
+   if constexpr (std::is_same_v<K, Key128>){
+      return Key128{i / 3, i};
+   } else {
+      return static_cast<K>(i);
+   }
+}
+
+template <class P>
+static P testPayload(uint64_t i)
+{
+   if constexpr (std::is_empty_v<P>){
+      return P{};
+   } else {
+      return static_cast<P>(i);
+   }
+}
+
+TEMPLATE_TEST_CASE("TEST OLC BTREE KEY AND PAYLOAD TYPES", "[ll-key-types]", (std::pair<uint32_t, uint32_t>),
+                   (std::pair<uint32_t, NoPayload>), (std::pair<uint64_t, NoPayload>), (std::pair<Key128, uint64_t>))
+{
+   using K = typename TestType::first_type;
+   using P = typename TestType::second_type;
+   OLC_BTree<K, P> tree;
+   const uint64_t n = 100000;
+   for(uint64_t i = 0; i < n; i++){
+      // every key once, in an order that splits leaves all over the tree
+      uint64_t k = (i * 7919) % n;
+      tree.upsert(testKey<K>(2*k), testPayload<P>(k));
+   }
+   for(uint64_t k = 0; k < n; k += 2){
+      REQUIRE(tree.remove(testKey<K>(2*k)));
+   }
+   for(uint64_t k = 0; k < 2*n; k++){
+      P result{};
+      bool expected = (k % 4 == 2);
+      REQUIRE(tree.lookup(testKey<K>(k),result) == expected);
+      if constexpr (!std::is_empty_v<P>){
+         if(expected) REQUIRE(result == testPayload<P>(k / 2));
+      }
+   }
+
+   std::vector<K> keys(n);
+   std::vector<P> payloads(n);
+   REQUIRE(tree.scan(testKey<K>(0), n, keys.data(), payloads.data()) == n / 2);
+   for(uint64_t i = 0; i < n / 2; i++){
+      REQUIRE(keys[i] == testKey<K>(4*i + 2));
+   }
+   K keysOnly[10];
+   REQUIRE(tree.scan(testKey<K>(7), 10, keysOnly, nullptr) == 10);
+   REQUIRE(keysOnly[0] == testKey<K>(10));
+
+   OLC_BTree<K, P> loaded;
+   loaded.bulkLoad(keys.data(), payloads.data(), n / 2);
+   for(uint64_t i = 0; i < n / 2; i++){
+      REQUIRE(loaded.lookup(keys[i], payloads[i]));
+   }
+}
+
+
+
+TEST_CASE("TEST OLC BTREE FANOUT OF SMALL KEYS", "[ll-key-types]")
+{
+   REQUIRE(BTreeLeaf<uint32_t, uint32_t>::maxEntries >= 2 * BTreeLeaf<>::maxEntries);
+   REQUIRE(BTreeLeaf<uint64_t, NoPayload>::maxEntries >= 2 * BTreeLeaf<>::maxEntries);
+   REQUIRE(BTreeInner<uint32_t>::maxEntries > BTreeInner<>::maxEntries);
+
+   // fits below a single root with 32-bit keys, but not with 64-bit keys
+   const uint64_t n = 150000;
+   std::vector<uint32_t> keys(n);
+   std::vector<uint64_t> wideKeys(n);
+   for(uint64_t i = 0; i < n; i++){
+      keys[i] = i;
+      wideKeys[i] = i;
+   }
+   OLC_BTree<uint32_t, uint32_t> small;
+   OLC_BTree<uint64_t, uint64_t> large;
+   small.bulkLoad(keys.data(), keys.data(), n);
+   large.bulkLoad(wideKeys.data(), wideKeys.data(), n);
+   REQUIRE(small.getHeight() == 2);
+   REQUIRE(large.getHeight() == 3);
+}
+
+
+
+TEST_CASE("TEST OLC BTREE SET", "[ll-set]")
+{
+   REQUIRE(BTreeLeaf<uint64_t, NoPayload>::maxEntries >= 2 * BTreeLeaf<>::maxEntries);
+   OLC_BTreeSet set;
+   const uint64_t n = 200000;
+   for(uint64_t k = 0; k < n; k++){
+      set.insert(3*k);
+   }
+   set.insert(0);
+   for(uint64_t k = 0; k < n; k += 2){
+      REQUIRE(set.remove(3*k));
+   }
+   REQUIRE_FALSE(set.remove(0));
+   for(uint64_t k = 0; k < 3*n; k++){
+      REQUIRE(set.contains(k) == (k % 6 == 3));
+   }
+
+   std::vector<Key> keys(n);
+   REQUIRE(set.scan(2, n, keys.data()) == n / 2);
+   for(uint64_t i = 0; i < n / 2; i++){
+      REQUIRE(keys[i] == 6*i + 3);
+   }
+
+   OLC_BTreeSet<uint32_t> loaded;
+   std::vector<uint32_t> smallKeys(keys.begin(), keys.begin() + n / 2);
+   loaded.bulkLoad(smallKeys.data(), smallKeys.size());
+   REQUIRE(loaded.getHeight() < set.getHeight());
+   for(uint64_t k = 0; k < 3*n; k++){
+      REQUIRE(loaded.contains(k) == (k % 6 == 3));
+   }
+}
+
+
+
+// URL like keys of very different lengths, most share their first bytes.
+static std::string testUrl(uint64_t i)
+{
+   std::string url = "https://example.com/" + std::to_string(i % 7) + "/";
+   url.append(i % 97, 'a' + i % 26);
+   return url + std::to_string(i);
+}
+
+TEST_CASE("TEST OLC STRING BTREE", "[ll-string-keys]")
+{
+   OLC_StringBTree tree;
+   std::map<std::string, Payload> expected;
+   const uint64_t n = 50000;
+   for(uint64_t i = 0; i < n; i++){
+      uint64_t k = (i * 7919) % n;
+      tree.upsert(testUrl(k), k);
+      expected[testUrl(k)] = k;
+   }
+   // keys that only differ behind the heads, in their length or in zero bytes
+   for(std::string k : {std::string(""), std::string("ab"), std::string("ab\0", 3), std::string("abc"),
+                        std::string(OLC_StringBTree::maxKeyLength, 'z')}){
+      tree.upsert(k, k.size());
+      expected[k] = k.size();
+   }
+   REQUIRE_THROWS_AS(tree.upsert(std::string(OLC_StringBTree::maxKeyLength + 1, 'z'), 0), std::length_error);
+   REQUIRE(tree.getHeight() > 2);
+
+   for(uint64_t k = 0; k < n; k += 3){
+      tree.upsert(testUrl(k), k + 1);
+      expected[testUrl(k)] = k + 1;
+   }
+   for(uint64_t k = 1; k < n; k += 3){
+      REQUIRE(tree.remove(testUrl(k)));
+      expected.erase(testUrl(k));
+   }
+   REQUIRE_FALSE(tree.remove(testUrl(1)));
+   REQUIRE_FALSE(tree.remove("https://"));
+
+   for(auto& [k, v] : expected){
+      Payload result = 0;
+      REQUIRE(tree.lookup(k,result));
+      REQUIRE(result == v);
+   }
+   Payload result = 0;
+   REQUIRE_FALSE(tree.lookup(testUrl(n), result));
+   REQUIRE_FALSE(tree.lookup("a", result));
+
+   std::vector<std::string> keys;
+   std::vector<Payload> payloads(expected.size());
+   REQUIRE(tree.scan("", expected.size() + 1, keys, payloads.data()) == expected.size());
+   uint64_t i = 0;
+   for(auto& [k, v] : expected){
+      REQUIRE(keys[i] == k);
+      REQUIRE(payloads[i] == v);
+      i++;
+   }
+   keys.clear();
+   REQUIRE(tree.scan("ab", 3, keys, nullptr) == 3);
+   REQUIRE(keys[0] == "ab");
+   REQUIRE(keys[1] == std::string("ab\0", 3));
+   REQUIRE(keys[2] == "abc");
+}
+
+TEST_CASE("TEST SHORTEST SEPARATORS", "[ll-separators]")
+{
+   REQUIRE(shortestSeparator<uint64_t>(3, 100) == 63);
+   REQUIRE(shortestSeparator<uint64_t>(99, 100) == 99);
+   REQUIRE(shortestSeparator<uint32_t>(0x12345678, 0x12400000) == 0x123fffff);
+   std::mt19937_64 rng(42);
+   for(unsigned i = 0; i < 100000; i++){
+      uint64_t a = rng() >> (rng() % 64), b = rng() >> (rng() % 64);
+      if(a == b) continue;
+      uint64_t s = shortestSeparator(std::min(a, b), std::max(a, b));
+      REQUIRE(std::min(a, b) <= s);
+      REQUIRE(s < std::max(a, b));
+   }
+
+   // keys that differ early and share a long tail, leaves split without pushing up the tail
+   OLC_StringBTree tree;
+   const uint64_t n = 20000;
+   std::string tail(200, 'x');
+   auto paddedKey = [&](uint64_t i) { return std::to_string(1000000 + i) + tail; };
+   for(uint64_t i = 0; i < n; i++){
+      uint64_t k = (i * 7919) % n;
+      tree.upsert(paddedKey(k), k);
+   }
+   REQUIRE(tree.getHeight() == 3); // 4 with whole keys as separators
+   for(uint64_t k = 0; k < n; k++){
+      Payload result = 0;
+      REQUIRE(tree.lookup(paddedKey(k), result));
+      REQUIRE(result == k);
+   }
+   std::vector<std::string> keys;
+   REQUIRE(tree.scan(paddedKey(n / 2), n, keys, nullptr) == n / 2);
+   REQUIRE(keys.front() == paddedKey(n / 2));
+}
+
+TEST_CASE("TEST OLC BTREE PREFIX COMPRESSED NODES", "[ll-prefix-nodes]")
+{
+   REQUIRE(PrefixLeaf<>::capacityFor(2) > 3 * BTreeLeaf<>::maxEntries / 2);
+   REQUIRE(PrefixInner<>::capacityFor(2) > 3 * BTreeInner<>::maxEntries / 2);
+   REQUIRE(PrefixLeaf<uint64_t, NoPayload>::capacityFor(2) > 3 * BTreeLeaf<uint64_t, NoPayload>::maxEntries);
+   // a tenant in the upper 16 bits, the lower bits count up
+   auto tenantKey = [](uint64_t tenant, uint64_t i) { return (tenant << 48) | i; };
+
+   // appends split full leaves with 2 byte suffixes, the packed leaves hold fewer keys
+   OLC_BTree<Key, Payload, OptLatch, PrefixNodes> tree;
+   OLC_BTree<Key, Payload> packed;
+   std::map<Key, Payload> reference;
+   const uint64_t n = 40000;
+   for(uint64_t i = 0; i < n; i++){
+      tree.upsert(tenantKey(7, i), i);
+      packed.upsert(tenantKey(7, i), i);
+      reference[tenantKey(7, i)] = i;
+   }
+   REQUIRE(tree.getHeight() < packed.getHeight());
+
+   // keys of other tenants and keys all over the key space widen the suffixes
+   std::mt19937_64 rng(42);
+   for(uint64_t i = 0; i < 5*n; i++){
+      Key k = (i % 100 == 0) ? rng() : tenantKey(rng() % 4, rng() % (1 << 20));
+      tree.upsert(k, i);
+      reference[k] = i;
+   }
+   for(Key k : {Key(0), Key(UINT64_MAX)}){
+      tree.upsert(k, k);
+      reference[k] = k;
+   }
+   for(auto& [k, v] : reference){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k, result));
+      REQUIRE(result == v);
+   }
+
+   // removes merge and rebalance nodes of different widths
+   uint64_t i = 0;
+   for(auto it = reference.begin(); it != reference.end();){
+      if(i++ % 4 != 0){
+         REQUIRE(tree.remove(it->first));
+         it = reference.erase(it);
+      } else {
+         ++it;
+      }
+   }
+   std::vector<Key> keys(reference.size());
+   std::vector<Payload> payloads(reference.size());
+   REQUIRE(tree.scan(0, keys.size(), keys.data(), payloads.data()) == reference.size());
+   i = 0;
+   for(auto& [k, v] : reference){
+      REQUIRE(keys[i] == k);
+      REQUIRE(payloads[i] == v);
+      i++;
+   }
+   uint64_t result = 0;
+   REQUIRE_FALSE(tree.lookup(tenantKey(7, 1), result));
+
+   OLC_BTree<Key, Payload, OptLatch, PrefixNodes> loaded;
+   loaded.bulkLoad(keys.data(), payloads.data(), keys.size());
+   for(uint64_t k = 0; k < n; k++){
+      loaded.upsert(tenantKey(9, 5*k), k);
+   }
+   for(uint64_t k = 0; k < n; k++){
+      REQUIRE(loaded.lookup(tenantKey(9, 5*k), result));
+      REQUIRE(result == k);
+   }
+   for(uint64_t j = 0; j < keys.size(); j++){
+      REQUIRE(loaded.lookup(keys[j], result));
+      REQUIRE(result == payloads[j]);
+   }
+
+   // bulk loaded leaves take as many clustered keys as fit with the suffixes they need, leaves
+   // across a 64K boundary need 4 bytes and hold fewer
+   std::vector<Key> clustered(90000);
+   for(uint64_t k = 0; k < clustered.size(); k++){
+      clustered[k] = tenantKey(3, 4*k);
+   }
+   OLC_BTree<Key, Payload, OptLatch, PrefixNodes> clusteredTree;
+   OLC_BTree<Key, Payload> clusteredPacked;
+   clusteredTree.bulkLoad(clustered.data(), clustered.data(), clustered.size());
+   clusteredPacked.bulkLoad(clustered.data(), clustered.data(), clustered.size());
+   REQUIRE(clusteredTree.getHeight() < clusteredPacked.getHeight());
+   // the last key shares no prefix with the others, the leaf that gets it holds whole keys
+   clustered.push_back(tenantKey(4, 0));
+   OLC_BTree<Key, Payload, OptLatch, PrefixNodes> mixed;
+   mixed.bulkLoad(clustered.data(), clustered.data(), clustered.size(), 0.5);
+   for(Key k : clustered){
+      REQUIRE(mixed.lookup(k, result));
+      REQUIRE(result == k);
+   }
+
+   // without payloads the halves of a rebalance may not fit, the leaves stay underfull then
+   OLC_BTreeSet<Key, OptLatch, PrefixNodes> set;
+   for(uint64_t k = 0; k < 4*n; k++){
+      set.insert(tenantKey(k % 3, k));
+   }
+   for(uint64_t k = 0; k < 4*n; k++){
+      if(k % 8 != 0) REQUIRE(set.remove(tenantKey(k % 3, k)));
+   }
+   for(uint64_t k = 0; k < 4*n; k++){
+      REQUIRE(set.contains(tenantKey(k % 3, k)) == (k % 8 == 0));
+   }
+
+   OLC_BTree<uint32_t, uint32_t, OptLatch, PrefixNodes> small;
+   for(uint32_t k = 0; k < 5*n; k++){
+      small.upsert(5*n - k, k);
+   }
+   for(uint32_t k = 0; k < 5*n; k++){
+      uint32_t value = 0;
+      REQUIRE(small.lookup(5*n - k, value));
+      REQUIRE(value == k);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE COMPACT NODE IDS", "[ll-node-ids]")
+{
+   using CompactInner = CompactNodes::Inner<Key, OptLatch>;
+   REQUIRE(sizeof(NodeId<NodeBase<OptLatch>>) == 4);
+   REQUIRE(CompactInner::maxEntries >= 4 * BTreeInner<>::maxEntries / 3);
+   REQUIRE(CompactNodes::Inner<uint32_t, OptLatch>::maxEntries >= 3 * BTreeInner<uint32_t>::maxEntries / 2);
+   REQUIRE(NodeArena::idOf(nullptr) == 0);
+   REQUIRE(NodeArena::nodeOf(0) == nullptr);
+
+   // 300 full leaves need two inner levels with pointers, but only one with ids
+   const uint64_t n = 300 * BTreeLeaf<>::maxEntries;
+   std::vector<Key> keys(n);
+   for(uint64_t i = 0; i < n; i++){
+      keys[i] = 3*i;
+   }
+   OLC_BTree<Key, Payload, OptLatch, CompactNodes> loaded;
+   OLC_BTree<Key, Payload> packed;
+   loaded.bulkLoad(keys.data(), keys.data(), n);
+   packed.bulkLoad(keys.data(), keys.data(), n);
+   REQUIRE(loaded.getHeight() == 2);
+   REQUIRE(packed.getHeight() == 3);
+
+   // splits, merges and rebalances move ids between nodes of both arenas
+   OLC_BTree<Key, Payload, OptLatch, CompactNodes> tree;
+   for(uint64_t i = 0; i < n; i++){
+      uint64_t k = (i * 7919) % n;
+      tree.upsert(keys[k], k);
+   }
+   for(uint64_t i = 0; i < n; i++){
+      if(i % 5 != 0) REQUIRE(tree.remove(keys[i]));
+   }
+   for(uint64_t i = 0; i < n; i++){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(keys[i], result) == (i % 5 == 0));
+      if(i % 5 == 0) REQUIRE(result == i);
+   }
+   std::vector<Key> scanned(n);
+   REQUIRE(tree.scan(0, n, scanned.data(), nullptr) == n / 5);
+   for(uint64_t i = 0; i < n / 5; i++){
+      REQUIRE(scanned[i] == keys[5*i]);
+   }
+
+   OLC_BTree<uint32_t, uint32_t, OptLatch, CompactNodes> small;
+   for(uint32_t k = 0; k < n; k++){
+      small.upsert(n - k, k);
+   }
+   for(uint32_t k = 0; k < n; k++){
+      uint32_t value = 0;
+      REQUIRE(small.lookup(n - k, value));
+      REQUIRE(value == k);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE FINGERPRINT LEAVES", "[ll-fingerprint-leaves]")
+{
+   REQUIRE(FingerprintLeaf<>::maxEntries > 9 * BTreeLeaf<>::maxEntries / 10);
+   OLC_BTree<Key, Payload, OptLatch, FingerprintNodes> tree;
+   std::map<Key, Payload> reference;
+   std::mt19937_64 rng(42);
+   const uint64_t n = 100000;
+   // random keys leave the leaves unsorted
+   for(uint64_t i = 0; i < n; i++){
+      Key k = rng() % (4*n);
+      tree.upsert(k, i);
+      reference[k] = i;
+   }
+   uint64_t i = 0;
+   for(auto& [k, v] : reference){
+      if(i++ % 8 == 0){
+         tree.upsert(k, ++v);
+      }
+   }
+   for(auto& [k, v] : reference){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k, result));
+      REQUIRE(result == v);
+   }
+
+   // removes move the last entry of a leaf into the gap
+   i = 0;
+   for(auto it = reference.begin(); it != reference.end();){
+      if(i++ % 3 == 0){
+         REQUIRE(tree.remove(it->first));
+         it = reference.erase(it);
+      } else {
+         ++it;
+      }
+   }
+   REQUIRE_FALSE(tree.remove(4*n));
+   uint64_t result = 0;
+   REQUIRE_FALSE(tree.lookup(4*n, result));
+
+   // scans sort the unsorted leaves they reach
+   std::vector<Key> keys(reference.size());
+   std::vector<Payload> payloads(reference.size());
+   REQUIRE(tree.scan(0, keys.size(), keys.data(), payloads.data()) == reference.size());
+   i = 0;
+   for(auto& [k, v] : reference){
+      REQUIRE(keys[i] == k);
+      REQUIRE(payloads[i] == v);
+      i++;
+   }
+   for(uint64_t j = 0; j < 1000; j++){
+      Key start = rng() % (4*n);
+      std::vector<Key> scanned(10);
+      uint64_t copied = tree.scan(start, 10, scanned.data(), nullptr);
+      auto it = reference.lower_bound(start);
+      for(uint64_t s = 0; s < copied; s++, ++it){
+         REQUIRE(scanned[s] == it->first);
+      }
+      REQUIRE((copied == 10 || it == reference.end()));
+   }
+
+   // bulk loaded leaves start sorted, appends keep them sorted
+   OLC_BTree<Key, Payload, OptLatch, FingerprintNodes> loaded;
+   loaded.bulkLoad(keys.data(), payloads.data(), keys.size());
+   for(uint64_t k = 1; k <= n; k++){
+      loaded.upsert(4*n + k, k);
+   }
+   std::vector<Key> appended(n);
+   REQUIRE(loaded.scan(4*n, n, appended.data(), nullptr) == n);
+   for(uint64_t k = 0; k < n; k++){
+      REQUIRE(appended[k] == 4*n + k + 1);
+   }
+   for(uint64_t j = 0; j < keys.size(); j++){
+      REQUIRE(loaded.lookup(keys[j], result));
+      REQUIRE(result == payloads[j]);
+   }
+
+   OLC_BTreeSet<Key, OptLatch, FingerprintNodes> set;
+   for(uint64_t k = 0; k < n; k++){
+      set.insert((k * 7919) % n);
+   }
+   for(uint64_t k = 0; k < n; k++){
+      if(k % 8 != 0) REQUIRE(set.remove(k));
+   }
+   std::vector<Key> remaining(n);
+   REQUIRE(set.scan(0, n, remaining.data()) == n / 8);
+   for(uint64_t k = 0; k < n / 8; k++){
+      REQUIRE(remaining[k] == 8*k);
+   }
+
+   OLC_BTree<uint32_t, uint32_t, OptLatch, FingerprintNodes> small;
+   for(uint32_t k = 0; k < n; k++){
+      small.upsert((k * 7919) % n, k);
+   }
+   for(uint32_t k = 0; k < n; k++){
+      uint32_t value = 0;
+      REQUIRE(small.lookup((k * 7919) % n, value));
+      REQUIRE(value == k);
+   }
+}
+
+TEST_CASE("TEST OLC BTREE GAPPED LEAVES", "[ll-gapped-leaves]")
+{
+   REQUIRE(GappedLeaf<>::maxEntries > 9 * BTreeLeaf<>::maxEntries / 10);
+   OLC_BTree<Key, Payload, OptLatch, GappedNodes> tree;
+   std::map<Key, Payload> reference;
+   std::mt19937_64 rng(42);
+   const uint64_t n = 100000;
+   // random inserts shift entries to the nearest gap in both directions
+   for(uint64_t i = 0; i < n; i++){
+      Key k = rng() % (4*n);
+      tree.upsert(k, i);
+      reference[k] = i;
+   }
+   uint64_t i = 0;
+   for(auto& [k, v] : reference){
+      if(i++ % 8 == 0){
+         tree.upsert(k, ++v);
+      }
+   }
+   for(auto& [k, v] : reference){
+      uint64_t result = 0;
+      REQUIRE(tree.lookup(k, result));
+      REQUIRE(result == v);
+   }
+
+   // removes leave gaps that later inserts reuse
+   i = 0;
+   for(auto it = reference.begin(); it != reference.end();){
+      if(i++ % 3 == 0){
+         REQUIRE(tree.remove(it->first));
+         REQUIRE_FALSE(tree.remove(it->first));
+         it = reference.erase(it);
+      } else {
+         ++it;
+      }
+   }
+   for(uint64_t j = 0; j < n / 4; j++){
+      Key k = rng() % (4*n);
+      tree.upsert(k, j);
+      reference[k] = j;
+   }
+   REQUIRE_FALSE(tree.remove(4*n));
+   uint64_t result = 0;
+   REQUIRE_FALSE(tree.lookup(4*n, result));
+
+   std::vector<Key> keys(reference.size());
+   std::vector<Payload> payloads(reference.size());
+   REQUIRE(tree.scan(0, keys.size(), keys.data(), payloads.data()) == reference.size());
+   i = 0;
+   for(auto& [k, v] : reference){
+      REQUIRE(keys[i] == k);
+      REQUIRE(payloads[i] == v);
+      i++;
+   }
+   for(uint64_t j = 0; j < 1000; j++){
+      Key start = rng() % (4*n);
+      std::vector<Key> scanned(10);
+      uint64_t copied = tree.scan(start, 10, scanned.data(), nullptr);
+      auto it = reference.lower_bound(start);
+      for(uint64_t s = 0; s < copied; s++, ++it){
+         REQUIRE(scanned[s] == it->first);
+      }
+      REQUIRE((copied == 10 || it == reference.end()));
+   }
+
+   // half full bulk loaded leaves have a gap behind every entry, appends fill the last slots
+   OLC_BTree<Key, Payload, OptLatch, GappedNodes> loaded;
+   loaded.bulkLoad(keys.data(), payloads.data(), keys.size(), 0.5);
+   for(uint64_t j = 0; j < keys.size(); j++){
+      if(!reference.count(keys[j] + 1)) loaded.upsert(keys[j] + 1, j);
+   }
+   for(uint64_t k = 1; k <= n; k++){
+      loaded.upsert(8*n + k, k);
+   }
+   for(uint64_t j = 0; j < keys.size(); j++){
+      REQUIRE(loaded.lookup(keys[j], result));
+      REQUIRE(result == payloads[j]);
+   }
+   std::vector<Key> appended(n);
+   REQUIRE(loaded.scan(8*n, n, appended.data(), nullptr) == n);
+   for(uint64_t k = 0; k < n; k++){
+      REQUIRE(appended[k] == 8*n + k + 1);
+   }
+
+   OLC_BTreeSet<Key, OptLatch, GappedNodes> set;
+   for(uint64_t k = 0; k < n; k++){
+      set.insert((k * 7919) % n);
+   }
+   for(uint64_t k = 0; k < n; k++){
+      if(k % 8 != 0) REQUIRE(set.remove(k));
+   }
+   std::vector<Key> remaining(n);
+   REQUIRE(set.scan(0, n, remaining.data()) == n / 8);
+   for(uint64_t k = 0; k < n / 8; k++){
+      REQUIRE(remaining[k] == 8*k);
+   }
+
+   OLC_BTree<uint32_t, uint32_t, OptLatch, GappedNodes> small;
+   for(uint32_t k = 0; k < n; k++){
+      small.upsert((k * 7919) % n, k);
+   }
+   for(uint32_t k = 0; k < n; k++){
+      uint32_t value = 0;
+      REQUIRE(small.lookup((k * 7919) % n, value));
+      REQUIRE(value == k);
+   }
+}